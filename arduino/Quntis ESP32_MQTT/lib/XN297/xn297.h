@@ -0,0 +1,62 @@
+#ifndef XN297_H
+#define XN297_H
+
+#include <Arduino.h>
+#include <RF24.h>
+#include <nRF24L01.h>
+
+// Frame with the scrambled address and a constant payload prefix already encoded,
+// only the remaining payload bytes and the CRC tail are added per packet
+struct XN297_Frame {
+    uint8_t buf[32];
+    uint8_t len;         // encoded bytes in buf (preamble byte + address + prefix)
+    uint8_t addr_len;
+    uint8_t prefix_len;  // payload bytes covered by the prefix
+    uint8_t msg_len;     // total payload length
+    uint16_t crc;        // CRC state after the prefix
+};
+
+class XN297 : public RF24 {
+   public:
+    XN297() {};
+    XN297(rf24_gpio_pin_t _cepin, rf24_gpio_pin_t _cspin);
+
+    void XN297_SetTXAddr(const uint8_t* addr, uint8_t len);
+    uint8_t XN297_WritePayload(uint8_t* msg, uint8_t len);
+
+    void XN297_PrepareFrame(XN297_Frame& frame, const uint8_t* msg, uint8_t prefix_len, uint8_t len);
+    void XN297_PrepareFrame(XN297_Frame& frame, const uint8_t* addr, const uint8_t* msg, uint8_t prefix_len, uint8_t len);
+    uint8_t XN297_FinishFrame(XN297_Frame& frame, const uint8_t* msg);
+    uint8_t XN297_WriteFrame(const uint8_t* buf, uint8_t len);
+    bool XN297_QueueFrame(const uint8_t* buf, uint8_t len);
+    bool XN297_TxDrained();
+
+    // Carrier sense in two steps, the caller returns in between: XN297_StartSense() listens on the
+    // channel, XN297_EndSense() returns the RPD bit (signal above -64 dBm) and leaves the radio in
+    // TX standby. Only start it with the TX FIFO drained.
+    void XN297_StartSense();
+    bool XN297_EndSense();
+
+    // Receive: frames are captured on the preamble, the address is checked after decoding
+    void XN297_SetRXAddr(const uint8_t* addr, uint8_t len);
+    uint8_t XN297_ReadPayload(uint8_t* msg, uint8_t len);
+    static bool XN297_Decode(const uint8_t* raw, uint8_t addr_len, uint8_t* addr, uint8_t* msg, uint8_t len);
+
+    static void HexDump(byte* buf, byte len);
+    long GetPacketCount() { return _nrOfPackets; }
+    void ResetPacketCount() { _nrOfPackets = 0; }
+
+   private:
+    static uint16_t crc16_update(uint16_t crc, unsigned char a);
+    static uint8_t bit_reverse(uint8_t b_in);
+
+    long _nrOfPackets;
+
+    // Codec state per instance, so several radios/addresses can be used side by side
+    uint8_t _addrLen = 5;
+    uint8_t _txAddr[5] = {0};
+    uint8_t _rxAddr[5] = {0};
+    bool _crcEnabled = true;
+};
+
+#endif
\ No newline at end of file
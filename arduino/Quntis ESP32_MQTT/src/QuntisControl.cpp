@@ -10,7 +10,15 @@ QuntisControl::QuntisControl() {
 // begin
 //=================================================================================================
 bool QuntisControl::begin() {
-    _index = 0;
+    if (!_txTimer) {
+        esp_timer_create_args_t args = {};
+        args.callback = &QuntisControl::TxTimerCallback;
+        args.arg = this;
+        args.name = "quntis_tx";
+        if (esp_timer_create(&args, &_txTimer) != ESP_OK) {
+            return false;
+        }
+    }
 
     // initialize the transceiver on the SPI bus
     if (!_radio.begin(CE_PIN, CSN_PIN)) {
@@ -43,59 +51,377 @@ bool QuntisControl::begin() {
     _radio.setRetries(0, 0);  // No retries needed (no auto-ack)
 
     _radio.XN297_SetTXAddr(_address, ADDRESS_LENGTH);
+    _radio.XN297_SetRXAddr(_address, ADDRESS_LENGTH);  // for PollRx(), frames are matched by QuntisLamp
+
+    // Lamp 0 is the configured _address/_payload, lamps from AddLamp() keep their slot
+    memcpy(_lamps[0].address, _address, ADDRESS_LENGTH);
+    memcpy(_lamps[0].payload, _payload, PAYLOAD_LENGTH);
+    if (_lampCount == 0) {
+        _lampCount = 1;
+    }
+    for (uint8_t i = 0; i < _lampCount; i++) {
+        Lamp& lamp = _lamps[i];
+        lamp.index = 0;
+        lamp.head = lamp.tail = 0;
+        lamp.left = 0;
+        _radio.XN297_PrepareFrame(lamp.frame, lamp.address, lamp.payload, PL_INDEX, PAYLOAD_LENGTH);
+    }
 
     // Dump RF24 register configuration for debugging
     _radio.printPrettyDetails();  // prints human readable register data
     return true;
 }
 
+//=================================================================================================
+// AddLamp
+//=================================================================================================
+int QuntisControl::AddLamp(const byte* address, const byte* payload) {
+    if (_lampCount == 0) {
+        _lampCount = 1;  // slot 0 stays reserved for _address/_payload
+    }
+    if (_lampCount >= MAX_LAMPS) {
+        return -1;
+    }
+
+    Lamp& lamp = _lamps[_lampCount];
+    memcpy(lamp.address, address, ADDRESS_LENGTH);
+    memcpy(lamp.payload, payload, PL_INDEX);
+    lamp.index = 0;
+    lamp.head = lamp.tail = 0;
+    lamp.left = 0;
+    _radio.XN297_PrepareFrame(lamp.frame, lamp.address, lamp.payload, PL_INDEX, PAYLOAD_LENGTH);
+
+    Serial.printf("[RF] Lamp %d: address %02X %02X %02X %02X %02X\n", _lampCount,
+                  address[0], address[1], address[2], address[3], address[4]);
+    return _lampCount++;
+}
+
 //=================================================================================================
 // OnOff
 //=================================================================================================
-void QuntisControl::OnOff() {
-    SendCommand(QUNTIS_CMD_ONOFF, true);
+bool QuntisControl::OnOff(uint8_t lamp) {
+    return SendCommand(lamp, QUNTIS_CMD_ONOFF, _repeatCount, _repeatGap);
 }
 
 //=================================================================================================
 // Dim
 //=================================================================================================
-void QuntisControl::Dim(bool up, bool repeat) {
-    SendCommand(QUNTIS_CMD_DIM | (byte)(up ? QUNTIS_CMD_UP : QUNTIS_CMD_DOWN), repeat);
+bool QuntisControl::Dim(bool up, bool repeat, uint8_t lamp, bool intermediate) {
+    return SendStep(lamp, QUNTIS_CMD_DIM | (byte)(up ? QUNTIS_CMD_UP : QUNTIS_CMD_DOWN), repeat, intermediate);
 }
 
 //=================================================================================================
 // Color
 //=================================================================================================
-void QuntisControl::Color(bool up, bool repeat) {
-    SendCommand(QUNTIS_CMD_COLOR | (byte)(up ? QUNTIS_CMD_UP : QUNTIS_CMD_DOWN), repeat);
+bool QuntisControl::Color(bool up, bool repeat, uint8_t lamp, bool intermediate) {
+    return SendStep(lamp, QUNTIS_CMD_COLOR | (byte)(up ? QUNTIS_CMD_UP : QUNTIS_CMD_DOWN), repeat, intermediate);
+}
+
+//=================================================================================================
+// GetStepRepeat
+//
+//      Copies an intermediate step needs so it is lost with less than TX_STEP_MISS chance
+//=================================================================================================
+uint8_t QuntisControl::GetStepRepeat() {
+    uint8_t count = 1;
+    float miss = _frameLoss;
+    while (count < _repeatCount && miss > TX_STEP_MISS) {
+        miss *= _frameLoss;
+        count++;
+    }
+    return count;
+}
+
+//=================================================================================================
+// SendStep
+//
+//      The copies an intermediate step leaves out count as saved once the step is queued
+//=================================================================================================
+bool QuntisControl::SendStep(uint8_t lamp, byte cmd, bool repeat, bool intermediate) {
+    uint16_t count = !repeat ? 1 : intermediate ? GetStepRepeat() : _repeatCount;
+    if (!SendCommand(lamp, cmd, count, _repeatGap)) {
+        return false;
+    }
+    if (repeat && intermediate) {
+        _framesSaved += _repeatCount - count;
+        _burstUsSaved += (uint64_t)(_repeatCount - count) * _repeatGap;
+    }
+    return true;
+}
+
+//=================================================================================================
+// ReportFrames
+//
+//      Moving average of the loss seen by a monitor receiver, small samples are too noisy
+//=================================================================================================
+void QuntisControl::ReportFrames(uint32_t sent, uint32_t heard) {
+    if (sent < 20) {
+        return;
+    }
+    float loss = heard >= sent ? 0.0f : 1.0f - (float)heard / sent;
+    _frameLoss = 0.8f * _frameLoss + 0.2f * loss;
+}
+
+//=================================================================================================
+// Ramp
+//=================================================================================================
+bool QuntisControl::Ramp(byte axis, bool up, uint32_t durationMs, uint8_t lamp) {
+    uint32_t frames = durationMs * 1000 / _holdGap + 1;
+    return SendCommand(lamp, axis | (byte)(up ? QUNTIS_CMD_UP : QUNTIS_CMD_DOWN), frames > UINT16_MAX ? UINT16_MAX : frames, _holdGap);
 }
 
 //=================================================================================================
 // SendCommand
+//
+//      Queue the command and return, TxTick() sends it once the lamp's earlier bursts are done.
+//      A full queue turns the command away instead of waiting for the radio.
 //=================================================================================================
-void QuntisControl::SendCommand(byte cmd, bool repeat) {
-    _payload[PL_CMD] = cmd;
-    _payload[PL_INDEX] = _index++;
+bool QuntisControl::SendCommand(uint8_t id, byte cmd, uint16_t count, uint32_t gap) {
+    if (id >= _lampCount) {
+        Serial.printf("[RF] SendCommand: unknown lamp %d\n", id);
+        return false;
+    }
 
-    Serial.printf("[RF] SendCommand cmd=0x%02X idx=%d repeat=%s payload=", cmd, _payload[PL_INDEX], repeat ? "true" : "false");
-    for (int i = 0; i < PAYLOAD_LENGTH; i++) {
-        Serial.printf("%02X ", _payload[i]);
+    Lamp& lamp = _lamps[id];
+    if ((uint8_t)(lamp.head - lamp.tail) >= TX_QUEUE_SIZE) {
+        Serial.printf("[RF] SendCommand lamp=%d cmd=0x%02X: queue full, dropped\n", id, cmd);
+        return false;
     }
-    Serial.println();
+    TxCommand tx = {cmd, lamp.index++, count, gap};
+
+    Serial.printf("[RF] SendCommand lamp=%d cmd=0x%02X idx=%d frames=%d queued=%d\n", id, cmd, tx.index, count, (uint8_t)(lamp.head - lamp.tail));
+
+    portENTER_CRITICAL(&_txMux);
+    lamp.queue[lamp.head % TX_QUEUE_SIZE] = tx;
+    lamp.head++;
+    bool start = !_txRunning;
+    _txRunning = true;
+    portEXIT_CRITICAL(&_txMux);
+
+    if (start) {
+        esp_timer_start_once(_txTimer, 1);
+    }
+    return true;
+}
+
+//=================================================================================================
+// TxTimerCallback
+//=================================================================================================
+void QuntisControl::TxTimerCallback(void* arg) {
+    static_cast<QuntisControl*>(arg)->TxTick();
+}
+
+//=================================================================================================
+// TxTick
+//
+//      Runs in the esp_timer task. Every lamp with a queued command gets a burst, and due frames
+//      go into the TX FIFO earliest deadline first, so one lamp's repeat gap carries the frames
+//      of the others. Re-arms itself for the next frame that is due.
+//=================================================================================================
+void QuntisControl::TxTick() {
+    if (_rxActive) {
+        StopRx();
+    }
+    uint32_t now = micros();
+
+    for (uint8_t i = 0; i < _lampCount; i++) {
+        Lamp& lamp = _lamps[i];
+        if (lamp.left == 0 && lamp.tail != lamp.head) {
+            lamp.current = lamp.queue[lamp.tail % TX_QUEUE_SIZE];
+            lamp.tail++;
 
-    if (repeat) {
-        for (int i = 0; i < TX_REPEAT; i++) {
-            bool ok = _radio.XN297_WritePayload(_payload, PAYLOAD_LENGTH);
-            if (i == 0) {
-                Serial.printf("[RF] XN297_WritePayload result: %s (sent %d/%d repeats)\n", ok ? "OK" : "FAIL", i + 1, TX_REPEAT);
+            // Encode once, every repeat is the same buffer
+            lamp.payload[PL_CMD] = lamp.current.cmd;
+            lamp.payload[PL_INDEX] = lamp.current.index;
+            lamp.frameLen = _radio.XN297_FinishFrame(lamp.frame, lamp.payload);
+            lamp.left = lamp.current.count;
+            lamp.next = now;
+            lamp.lastFrameUs = 0;
+            lamp.queuedUs = now;
+            lamp.deferrals = 0;
+        }
+    }
+
+    while (true) {
+        // While the radio listens before a burst nothing else goes out
+        Lamp* due = nullptr;
+        if (_sensing) {
+            due = (int32_t)(now - _sensing->next) >= 0 ? _sensing : nullptr;
+        }
+        for (uint8_t i = 0; i < _lampCount && !_sensing; i++) {
+            Lamp& lamp = _lamps[i];
+            if (lamp.left > 0 && (int32_t)(now - lamp.next) >= 0 && (!due || (int32_t)(lamp.next - due->next) < 0)) {
+                due = &lamp;
             }
-            delay(TX_REPEAT_DELAY);
         }
-        Serial.printf("[RF] Sent %d repeats total, packets=%ld\n", TX_REPEAT, _radio.GetPacketCount());
+        if (!due) {
+            break;
+        }
+        if (due->left == due->current.count && TxHoldBurst(*due, now)) {
+            continue;
+        }
+        if (!_radio.XN297_QueueFrame(due->frame.buf, due->frameLen)) {
+            break;
+        }
+        TxRecordFrame(*due, now);
+        due->next += due->current.gap;
+        if (--due->left == 0 && _txDone) {
+            _txDone(due - _lamps, due->current.cmd);
+        }
+    }
+
+    // Next tick: the earliest frame still to send, a lamp with more queued, or the FIFO draining
+    bool pending = false;
+    int32_t wait = INT32_MAX;
+    now = micros();
+    for (uint8_t i = 0; i < _lampCount; i++) {
+        Lamp& lamp = _lamps[i];
+        if (lamp.left > 0) {
+            pending = true;
+            if ((int32_t)(lamp.next - now) < wait) {
+                wait = (int32_t)(lamp.next - now);
+            }
+        } else if (lamp.tail != lamp.head) {
+            pending = true;
+            wait = 0;
+        }
+    }
+    if (_sensing) {
+        wait = (int32_t)(_sensing->next - now);
+    }
+
+    if (!pending) {
+        if (!_radio.XN297_TxDrained()) {
+            esp_timer_start_once(_txTimer, TX_FIFO_POLL_US);
+            return;
+        }
+
+        // Stop unless SendCommand() queued something meanwhile
+        portENTER_CRITICAL(&_txMux);
+        for (uint8_t i = 0; i < _lampCount && !pending; i++) {
+            pending = _lamps[i].tail != _lamps[i].head;
+        }
+        _txRunning = pending;
+        portEXIT_CRITICAL(&_txMux);
+
+        if (!pending) {
+            if (_rxFrame) {
+                StartRx();
+            }
+            return;
+        }
+        wait = 0;
+    }
+
+    esp_timer_start_once(_txTimer, wait > 0 ? wait : TX_FIFO_POLL_US);
+}
+
+//=================================================================================================
+// TxHoldBurst
+//
+//      Before the first frame of a burst: wait for a WiFi idle window and/or listen on the
+//      channel. Returns true and moves lamp.next when the burst has to wait, false to send now.
+//      The listen spans two ticks, the timer comes back for the RPD bit instead of waiting here.
+//=================================================================================================
+bool QuntisControl::TxHoldBurst(Lamp& lamp, uint32_t now) {
+    if (_sensing != &lamp) {
+        if (_wifiAlign && (uint32_t)(now - _wifiIdleUs) > TX_WIFI_WINDOW_US && (uint32_t)(now - lamp.queuedUs) < TX_WIFI_WAIT_US) {
+            if (lamp.next == lamp.queuedUs) {
+                _carrierStats.aligned++;
+            }
+            lamp.next = now + TX_WIFI_POLL_US;
+            return true;
+        }
+
+        // Our own frames still in the FIFO would trip RPD, the channel is ours then anyway
+        if (_carrierSense && _radio.XN297_TxDrained()) {
+            _carrierStats.senses++;
+            _radio.XN297_StartSense();
+            _sensing = &lamp;
+            lamp.next = now + TX_SENSE_US;
+            return true;
+        }
     } else {
-        bool ok = _radio.XN297_WritePayload(_payload, PAYLOAD_LENGTH);
-        Serial.printf("[RF] XN297_WritePayload result: %s, packets=%ld\n", ok ? "OK" : "FAIL", _radio.GetPacketCount());
+        _sensing = nullptr;
+        if (_radio.XN297_EndSense()) {
+            _carrierStats.busy++;
+            if (lamp.deferrals < TX_MAX_DEFER) {
+                if (lamp.deferrals++ == 0) {
+                    _carrierStats.deferred++;
+                }
+                // Random part so two senders that backed off together do not retry together
+                uint32_t backoff = TX_BACKOFF_US << (lamp.deferrals - 1);
+                lamp.next = micros() + backoff + random(backoff);
+                return true;
+            }
+            _carrierStats.forced++;
+        }
+    }
+
+    _carrierStats.bursts++;
+    _carrierStats.waitUs += (uint32_t)(micros() - lamp.queuedUs);
+    return false;
+}
+
+//=================================================================================================
+// SetRxCallback
+//=================================================================================================
+void QuntisControl::SetRxCallback(std::function<void(const uint8_t* raw, uint8_t len)> callback) {
+    _rxFrame = callback;
+    if (_rxFrame && !_txRunning && !_rxActive) {
+        StartRx();
+    }
+}
+
+//=================================================================================================
+// PollRx
+//
+//      Runs in the loop task, which is also the only one that starts the TX timer, so the radio
+//      is ours whenever RX is active and no burst is queued
+//=================================================================================================
+void QuntisControl::PollRx() {
+    uint8_t raw[ADDRESS_LENGTH + PAYLOAD_LENGTH + 2];
+
+    while (_rxActive && !_txRunning && _radio.available()) {
+        _radio.read(raw, sizeof(raw));
+        _rxFrames++;
+        if (_rxFrame) {
+            _rxFrame(raw, sizeof(raw));
+        }
+    }
+}
+
+//=================================================================================================
+// StartRx / StopRx
+//=================================================================================================
+void QuntisControl::StartRx() {
+    _radio.startListening();
+    _rxActive = true;
+}
+
+void QuntisControl::StopRx() {
+    _rxActive = false;
+    _radio.stopListening();
+}
+
+//=================================================================================================
+// TxRecordFrame
+//
+//      Histogram of how far the spacing between two frames of a burst is off its gap
+//=================================================================================================
+void QuntisControl::TxRecordFrame(Lamp& lamp, uint32_t now) {
+    static const uint32_t limits[TX_JITTER_BUCKETS - 1] = {50, 100, 250, 500, 1000, 2500, 5000};
+
+    if (lamp.lastFrameUs != 0) {
+        int32_t deviation = (int32_t)(now - lamp.lastFrameUs - lamp.current.gap);
+        uint32_t jitter = deviation < 0 ? -deviation : deviation;
+        uint8_t bucket = 0;
+        while (bucket < TX_JITTER_BUCKETS - 1 && jitter >= limits[bucket]) {
+            bucket++;
+        }
+        _jitterHist[bucket]++;
     }
+    lamp.lastFrameUs = now;
 }
 
 //=================================================================================================
@@ -104,6 +430,15 @@ void QuntisControl::SendCommand(byte cmd, bool repeat) {
 void QuntisControl::ShowNrOfPacketsSend() {
     Serial.print("Packets send:#");
     Serial.println(_radio.GetPacketCount());
+    Serial.printf("Frame loss estimate %.1f%%, %d copies per intermediate step, saved %lu frames (%lu ms)\n",
+                  _frameLoss * 100, GetStepRepeat(), (unsigned long)_framesSaved, (unsigned long)GetBurstTimeSavedMs());
+
+    const CarrierStats& cs = _carrierStats;
+    Serial.printf("Carrier sense %s, WiFi align %s: %lu bursts, %lu/%lu checks busy, %lu deferred, %lu forced, "
+                  "%lu waited for WiFi, avg start delay %luus\n",
+                  _carrierSense ? "on" : "off", _wifiAlign ? "on" : "off", (unsigned long)cs.bursts, (unsigned long)cs.busy,
+                  (unsigned long)cs.senses, (unsigned long)cs.deferred, (unsigned long)cs.forced, (unsigned long)cs.aligned,
+                  (unsigned long)(cs.bursts ? cs.waitUs / cs.bursts : 0));
 }
 
 //=================================================================================================
@@ -111,4 +446,21 @@ void QuntisControl::ShowNrOfPacketsSend() {
 //=================================================================================================
 void QuntisControl::ResetNrOfPacketsSend() {
     _radio.ResetPacketCount();
+    memset(_jitterHist, 0, sizeof(_jitterHist));
+    _framesSaved = 0;
+    _burstUsSaved = 0;
+    _carrierStats = {};
+}
+
+//=================================================================================================
+// ShowJitterHistogram
+//=================================================================================================
+void QuntisControl::ShowJitterHistogram() {
+    static const char* labels[TX_JITTER_BUCKETS] = {"<50us", "<100us", "<250us", "<500us", "<1ms", "<2.5ms", "<5ms", ">=5ms"};
+
+    Serial.printf("Frame gap jitter (gap %luus):", (unsigned long)_repeatGap);
+    for (int i = 0; i < TX_JITTER_BUCKETS; i++) {
+        Serial.printf(" %s=%lu", labels[i], (unsigned long)_jitterHist[i]);
+    }
+    Serial.println();
 }
@@ -9,8 +9,11 @@
 //=================================================================================================
 //	(c) 2023 LEXYINDUSTRIES
 //=================================================================================================
+#include <esp_timer.h>
 #include <xn297.h>
 
+#include <functional>
+
 // ESP32-C3 Super Mini (lolin_c3_mini) SPI pins for NRF24L01:
 // GND  → GND    (black)
 // VCC  → 3.3V   (gray)
@@ -22,11 +25,26 @@
 #define CE_PIN 1
 #define CSN_PIN 5
 
-#define TX_REPEAT 6
-#define TX_REPEAT_DELAY 5
+#define TX_REPEAT 6            // default frames per burst, see SetRepeatCount()
+#define TX_REPEAT_GAP_US 5000  // default gap between repeats, see SetRepeatGap()
+#define TX_HOLD_GAP_US 5000    // frame spacing of a held button until the remote's is heard, see SetHoldGap()
+#define TX_LOSS_DEFAULT 0.5f   // frame loss assumed until measured, high enough to keep full bursts
+#define TX_STEP_MISS 0.001f    // accepted chance to lose an intermediate step of a ramp
 #define PAYLOAD_LENGTH 6
 #define ADDRESS_LENGTH 5
 
+#define MAX_LAMPS 4            // lamps sharing the radio, each with its own address/payload/index
+#define TX_QUEUE_SIZE 8        // commands waiting for the radio, per lamp
+#define TX_FIFO_POLL_US 150    // timer tick while the TX FIFO is full or drains at the end
+#define TX_JITTER_BUCKETS 8    // frame gap deviation: <50us <100 <250 <500 <1ms <2.5ms <5ms >=5ms
+
+#define TX_SENSE_US 200        // listen time before a burst, see SetCarrierSense()
+#define TX_BACKOFF_US 1000     // first backoff on a busy channel, doubles with every retry
+#define TX_MAX_DEFER 4         // busy retries before a burst goes out anyway
+#define TX_WIFI_WINDOW_US 5000 // bursts may start this long after NotifyWifiIdle()
+#define TX_WIFI_WAIT_US 30000  // longest a burst waits for a WiFi idle window
+#define TX_WIFI_POLL_US 1000   // timer tick while a burst waits for the window
+
 // index in _payload
 #define PL_INDEX 4
 #define PL_CMD 5
@@ -52,15 +70,135 @@ class QuntisControl {
 
     bool begin();
 
-    void OnOff();
-    void Dim(bool up, bool repeat = true);
-    void Color(bool up, bool repeat = true);
+    // Lamp 0 is _address/_payload below, more lamps can be added and share the radio.
+    // Returns the lamp id to pass to OnOff/Dim/Color, -1 when MAX_LAMPS is reached.
+    int AddLamp(const byte* address, const byte* payload);
+    uint8_t GetLampCount() { return _lampCount; }
+
+    // intermediate: a step that a later one in the same direction follows, it gets only as many
+    // copies as the loss estimate needs. OnOff and final steps always get the full repeat count.
+    // All of them return false without queueing when the lamp already has TX_QUEUE_SIZE commands
+    // waiting, the caller tries again once the radio caught up (see IsTxIdle()).
+    bool OnOff(uint8_t lamp = 0);
+    bool Dim(bool up, bool repeat = true, uint8_t lamp = 0, bool intermediate = false);
+    bool Color(bool up, bool repeat = true, uint8_t lamp = 0, bool intermediate = false);
+
+    // Press-and-hold like the original remote: one command index streamed for the duration,
+    // the lamp keeps stepping while it hears it. axis is QUNTIS_CMD_DIM or QUNTIS_CMD_COLOR.
+    bool Ramp(byte axis, bool up, uint32_t durationMs, uint8_t lamp = 0);
+
+    void SetRepeatGap(uint32_t gap_us) { _repeatGap = gap_us; }
+    uint32_t GetRepeatGap() { return _repeatGap; }
+    void SetRepeatCount(uint8_t count) { _repeatCount = count ? count : 1; }
+    uint8_t GetRepeatCount() { return _repeatCount; }
+
+    // Running frame loss estimate, fed from a monitor receiver (frames heard of frames sent)
+    void SetLossEstimate(float loss) { _frameLoss = constrain(loss, 0.0f, 1.0f); }
+    float GetLossEstimate() { return _frameLoss; }
+    void ReportFrames(uint32_t sent, uint32_t heard);
+    uint8_t GetStepRepeat();
+
+    // Frame spacing of a Ramp(). Starts at the gap the remote leaves between the frames of a press
+    // burst, MqttManager sets it to the spacing of a held button once it hears one (RF_LISTEN_REMOTE).
+    void SetHoldGap(uint32_t gap_us) { _holdGap = gap_us ? gap_us : 1; }
+    uint32_t GetHoldGap() { return _holdGap; }
+
+    // Steps per second a hold achieves, measured with the 'h' calibration in main (0 = unknown,
+    // planners stick to single steps)
+    void SetHoldRate(float stepsPerSec) { _holdRate = stepsPerSec; }
+    float GetHoldRate() { return _holdRate; }
+
+    // Commands are queued and return at once, the bursts go out on esp_timer ticks.
+    // Bursts of different lamps are interleaved, so N lamps take about as long as one.
+    // The done callback runs in the esp_timer task, keep it short.
+    void SetTxDoneCallback(std::function<void(uint8_t lamp, byte cmd)> callback) { _txDone = callback; }
+    bool IsTxIdle() { return !_txRunning; }
+
+    // Carrier sense: listen before each burst and back off while the channel is busy (WiFi on
+    // the same band), a burst is deferred at most TX_MAX_DEFER times.
+    void SetCarrierSense(bool enabled) { _carrierSense = enabled; }
+    bool GetCarrierSense() { return _carrierSense; }
+
+    // WiFi alignment: bursts start right after NotifyWifiIdle(), call it when the network stack
+    // has just been serviced (after the MQTT loop). Waits at most TX_WIFI_WAIT_US for it.
+    void SetWifiAlign(bool enabled) { _wifiAlign = enabled; }
+    void NotifyWifiIdle() { _wifiIdleUs = micros(); }
+
+    struct CarrierStats {
+        uint32_t bursts;    // bursts started
+        uint32_t senses;    // channel checks
+        uint32_t busy;      // checks that found the channel busy
+        uint32_t deferred;  // bursts that backed off at least once
+        uint32_t forced;    // bursts sent on a busy channel after TX_MAX_DEFER retries
+        uint32_t aligned;   // bursts that waited for a WiFi idle window
+        uint64_t waitUs;    // total start delay from backoffs and window waits
+    };
+    const CarrierStats& GetCarrierStats() { return _carrierStats; }
+
+    // Listen for the original remote while no burst is on air. PollRx() hands every frame in the
+    // RX FIFO to the callback (raw, see QuntisLamp::Accept), call it from loop(). Frames sent
+    // while we transmit are missed.
+    void SetRxCallback(std::function<void(const uint8_t* raw, uint8_t len)> callback);
+    void PollRx();
+    uint32_t GetRxFrameCount() { return _rxFrames; }
+
+    const byte* GetAddress() { return _address; }
+    const byte* GetPayload() { return _payload; }
+
+    // Index the next command goes out with. After a reset it has to move past the last one the
+    // lamp saw, or the lamp drops the first command as a repeat.
+    byte GetIndex(uint8_t lamp = 0) { return lamp < _lampCount ? _lamps[lamp].index : 0; }
+    void SetIndex(byte index, uint8_t lamp = 0) {
+        if (lamp < _lampCount) _lamps[lamp].index = index;
+    }
 
     void ShowNrOfPacketsSend();
     void ResetNrOfPacketsSend();
+    void ShowJitterHistogram();
+    uint32_t GetFramesSaved() { return _framesSaved; }
+    uint32_t GetBurstTimeSavedMs() { return _burstUsSaved / 1000; }
+    const uint32_t* GetJitterHistogram() { return _jitterHist; }
 
    private:
-    void SendCommand(byte cmd, bool repeat);
+    struct TxCommand {
+        byte cmd;
+        byte index;
+        uint16_t count;
+        uint32_t gap;
+    };
+
+    struct Lamp {
+        byte address[ADDRESS_LENGTH];
+        byte payload[PAYLOAD_LENGTH];
+        byte index;
+
+        // Address and fixed payload part encoded once, each command only adds idx/cmd
+        XN297_Frame frame;
+        uint8_t frameLen;
+
+        // SendCommand() adds at head and the timer takes from tail
+        TxCommand queue[TX_QUEUE_SIZE];
+        volatile uint8_t head;
+        volatile uint8_t tail;
+
+        // Burst on air, only touched from the timer
+        TxCommand current;
+        uint16_t left;
+        uint32_t next;
+        uint32_t lastFrameUs;
+        uint32_t queuedUs;  // when the burst was taken from the queue
+        uint8_t deferrals;
+    };
+
+    bool SendCommand(uint8_t lamp, byte cmd, uint16_t count, uint32_t gap);
+    bool SendStep(uint8_t lamp, byte cmd, bool repeat, bool intermediate);
+
+    static void TxTimerCallback(void* arg);
+    void TxTick();
+    void TxRecordFrame(Lamp& lamp, uint32_t now);
+    bool TxHoldBurst(Lamp& lamp, uint32_t now);
+    void StartRx();
+    void StopRx();
 
    private:
     XN297 _radio;
@@ -73,7 +211,31 @@ class QuntisControl {
     //                               |------ Fixed -------| |Idx|  |cmd|
     byte _payload[PAYLOAD_LENGTH] = {0x00, 0x76, 0x9A, 0x31, 0x00, 0x00};
 
-    byte _index;
+    Lamp _lamps[MAX_LAMPS];
+    uint8_t _lampCount = 0;
+
+    uint32_t _repeatGap = TX_REPEAT_GAP_US;
+    uint8_t _repeatCount = TX_REPEAT;
+    float _frameLoss = TX_LOSS_DEFAULT;
+    uint32_t _framesSaved = 0;
+    uint64_t _burstUsSaved = 0;
+    uint32_t _holdGap = TX_HOLD_GAP_US;
+    float _holdRate = 0;
+    volatile bool _txRunning = false;
+    portMUX_TYPE _txMux = portMUX_INITIALIZER_UNLOCKED;
+    esp_timer_handle_t _txTimer = nullptr;
+    std::function<void(uint8_t lamp, byte cmd)> _txDone;
+    uint32_t _jitterHist[TX_JITTER_BUCKETS] = {0};
+
+    bool _carrierSense = false;
+    Lamp* _sensing = nullptr;  // the lamp whose burst the radio listens before, see TxHoldBurst()
+    bool _wifiAlign = false;
+    volatile uint32_t _wifiIdleUs = 0;
+    CarrierStats _carrierStats = {};
+
+    std::function<void(const uint8_t* raw, uint8_t len)> _rxFrame;
+    volatile bool _rxActive = false;
+    uint32_t _rxFrames = 0;
 };
 
 #endif
\ No newline at end of file
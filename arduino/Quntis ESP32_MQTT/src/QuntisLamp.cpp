@@ -0,0 +1,123 @@
+#include <QuntisLamp.h>
+
+//=================================================================================================
+// QuntisLamp
+//=================================================================================================
+QuntisLamp::QuntisLamp(const byte* address, const byte* payload, int brightnessSteps, int colorSteps)
+    : _brightnessSteps(brightnessSteps), _colorSteps(colorSteps) {
+    memcpy(_address, address, ADDRESS_LENGTH);
+    memcpy(_payload, payload, PL_INDEX);
+}
+
+//=================================================================================================
+// Accept
+//=================================================================================================
+bool QuntisLamp::Accept(const uint8_t* raw, uint8_t len) {
+    uint8_t addr[ADDRESS_LENGTH];
+    uint8_t msg[PAYLOAD_LENGTH];
+
+    _stats.frames++;
+    if (len < ADDRESS_LENGTH + PAYLOAD_LENGTH + 2 || !XN297::XN297_Decode(raw, ADDRESS_LENGTH, addr, msg, PAYLOAD_LENGTH)) {
+        _stats.crcErrors++;
+        return false;
+    }
+    if (memcmp(addr, _address, ADDRESS_LENGTH) != 0 || memcmp(msg, _payload, PL_INDEX) != 0) {
+        _stats.foreign++;
+        return false;
+    }
+    return Apply(msg);
+}
+
+//=================================================================================================
+// Apply
+//=================================================================================================
+bool QuntisLamp::Apply(const uint8_t* payload) {
+    byte cmd = payload[PL_CMD];
+    uint32_t now = micros();
+
+    if (_hasIndex && payload[PL_INDEX] == _lastIndex) {
+        _stats.duplicates++;
+        _indexFrames++;
+        _lastFrameUs = now;
+
+        // Still held: catch up with the steps the lamp made since the first frame
+        int held = _holdRate > 0 ? (int)((millis() - _indexMs) * _holdRate / 1000) : 0;
+        if (cmd == QUNTIS_CMD_ONOFF || held <= _indexSteps) {
+            return false;
+        }
+        int count = held - _indexSteps;
+        _indexSteps = held;
+        return Step(cmd, count);
+    }
+    if (_indexFrames > TX_REPEAT) {
+        _holdGapUs = (_lastFrameUs - _indexUs) / (_indexFrames - 1);
+    }
+    _lastIndex = payload[PL_INDEX];
+    _hasIndex = true;
+    _indexMs = millis();
+    _indexUs = _lastFrameUs = now;
+    _indexFrames = 1;
+    _indexSteps = 1;
+    _stats.commands++;
+
+    if (cmd == QUNTIS_CMD_ONOFF) {
+        _power = !_power;
+        return true;
+    }
+    return Step(cmd, 1);
+}
+
+//=================================================================================================
+// Step
+//=================================================================================================
+bool QuntisLamp::Step(byte cmd, int count) {
+    if (!_power) {
+        _stats.ignored++;
+        return false;
+    }
+
+    int step = (cmd & QUNTIS_CMD_DOWN) ? -count : count;
+    int* value;
+    int max;
+    switch (cmd & ~QUNTIS_CMD_DOWN) {
+        case QUNTIS_CMD_DIM:
+            value = &_brightness;
+            max = _brightnessSteps;
+            break;
+        case QUNTIS_CMD_COLOR:
+            value = &_color;
+            max = _colorSteps;
+            break;
+        default:
+            return false;
+    }
+
+    int next = constrain(*value + step, 0, max);
+    if (next == *value) {
+        _stats.clamped++;
+        return false;
+    }
+    *value = next;
+    return true;
+}
+
+//=================================================================================================
+// Reset
+//=================================================================================================
+void QuntisLamp::Reset(bool power, int brightness, int color) {
+    _power = power;
+    _brightness = constrain(brightness, 0, _brightnessSteps);
+    _color = constrain(color, 0, _colorSteps);
+}
+
+//=================================================================================================
+// ShowStats
+//=================================================================================================
+void QuntisLamp::ShowStats() {
+    Serial.printf("Lamp: power=%s brightness=%d/%d color=%d/%d idx=%d\n", _power ? "ON" : "OFF",
+                  _brightness, _brightnessSteps, _color, _colorSteps, _lastIndex);
+    Serial.printf("  frames=%lu crc=%lu foreign=%lu dup=%lu cmds=%lu clamped=%lu ignored=%lu\n",
+                  (unsigned long)_stats.frames, (unsigned long)_stats.crcErrors, (unsigned long)_stats.foreign,
+                  (unsigned long)_stats.duplicates, (unsigned long)_stats.commands, (unsigned long)_stats.clamped,
+                  (unsigned long)_stats.ignored);
+}
@@ -0,0 +1,83 @@
+//
+//	QuntisLamp.h
+//
+//	    Model of the receiving side of a Quntis ScreenLinear lamp: which frames it
+//	    acts on and what they do to its power, brightness and color
+//
+//=================================================================================================
+#include <QuntisControl.h>
+
+//=================================================================================================
+//	QuntisLamp
+//=================================================================================================
+#ifndef QUNTISLAMP_H
+#define QUNTISLAMP_H
+
+class QuntisLamp {
+   public:
+    QuntisLamp(const byte* address, const byte* payload, int brightnessSteps, int colorSteps);
+
+    // Raw frame as captured in RX (see XN297::XN297_SetRXAddr): decoded, CRC checked and
+    // matched against our address and fixed payload before it is handed to Apply()
+    bool Accept(const uint8_t* raw, uint8_t len);
+
+    // Decoded payload. The lamp acts once per index, the repeats of a burst carry the same
+    // one. Returns true when the command was new and changed the model.
+    bool Apply(const uint8_t* payload);
+
+    void Reset(bool power, int brightness, int color);
+
+    // A held button repeats one index for as long as it is held and the lamp keeps stepping
+    // at this rate (see QuntisControl::SetHoldRate). 0 counts every index as a single step.
+    void SetHoldRate(float stepsPerSec) { _holdRate = stepsPerSec; }
+
+    // Mean frame spacing of the last index that ran past a press burst (TX_REPEAT frames), known
+    // once the next index arrives, 0 before. Frames are timed when they are handed in, so the
+    // receiver has to be drained before its FIFO fills; over a whole hold the polling evens out.
+    uint32_t GetHoldGapUs() { return _holdGapUs; }
+
+    // Steps are counted in commands: brightness goes up with Dim(true), color with Color(true).
+    // Both clamp at the end stops, the lamp ignores steps past them.
+    bool GetPower() { return _power; }
+    int GetBrightness() { return _brightness; }
+    int GetColor() { return _color; }
+    byte GetLastIndex() { return _lastIndex; }
+
+    struct Stats {
+        uint32_t frames;      // handed to Accept()
+        uint32_t crcErrors;
+        uint32_t foreign;     // other address or fixed payload
+        uint32_t duplicates;  // repeats of an index already acted on
+        uint32_t commands;    // acted on
+        uint32_t clamped;     // steps past an end stop
+        uint32_t ignored;     // steps while off
+    };
+    const Stats& GetStats() { return _stats; }
+    void ShowStats();
+
+   private:
+    bool Step(byte cmd, int count);
+
+    byte _address[ADDRESS_LENGTH];
+    byte _payload[PL_INDEX];
+    int _brightnessSteps;
+    int _colorSteps;
+
+    bool _power = false;
+    int _brightness = 0;
+    int _color = 0;
+    byte _lastIndex = 0;
+    bool _hasIndex = false;
+
+    float _holdRate = 0;
+    unsigned long _indexMs = 0;  // first frame of the last index
+    int _indexSteps = 0;         // steps the last index accounted for
+    uint32_t _indexUs = 0;       // first and last frame of the last index, for GetHoldGapUs()
+    uint32_t _lastFrameUs = 0;
+    uint32_t _indexFrames = 0;
+    uint32_t _holdGapUs = 0;
+
+    Stats _stats = {};
+};
+
+#endif
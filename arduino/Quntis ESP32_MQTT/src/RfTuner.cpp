@@ -0,0 +1,134 @@
+#include <Preferences.h>
+#include <RfTuner.h>
+
+//=================================================================================================
+// Tune
+//=================================================================================================
+RfTuner::Result RfTuner::Tune(uint8_t maxRepeat, uint32_t maxGap) {
+    uint8_t repeat;
+    uint32_t gap;
+
+    Start(maxRepeat, maxGap);
+    while (Next(repeat, gap)) {
+        Report(_trial(repeat, gap));
+    }
+    return _result;
+}
+
+//=================================================================================================
+// Start / Next / Report
+//=================================================================================================
+void RfTuner::Start(uint8_t maxRepeat, uint32_t maxGap) {
+    _result = {maxRepeat, maxGap, TUNE_LOSS_UNKNOWN, false};
+    _trials = 0;
+    _phase = TUNE_START;
+    _maxRepeat = _repeat = maxRepeat;
+    _gap = maxGap;
+}
+
+bool RfTuner::Next(uint8_t& repeat, uint32_t& gap) {
+    if (_phase == TUNE_REPEAT && _repeat <= 1) {
+        _phase = TUNE_GAP;
+    }
+    if (_phase == TUNE_GAP && _gap <= TUNE_MIN_GAP_US) {
+        Finish();
+    }
+
+    switch (_phase) {
+        case TUNE_START:
+            _nextRepeat = _repeat;
+            _nextGap = _gap;
+            break;
+        case TUNE_REPEAT:
+            _nextRepeat = _repeat - 1;
+            _nextGap = _gap;
+            break;
+        case TUNE_GAP:
+            _nextRepeat = _repeat;
+            _nextGap = _gap / 2 < TUNE_MIN_GAP_US ? TUNE_MIN_GAP_US : _gap / 2;
+            break;
+        default:
+            return false;
+    }
+    repeat = _nextRepeat;
+    gap = _nextGap;
+    return true;
+}
+
+void RfTuner::Report(float loss) {
+    _trials++;
+    Serial.printf("[Tune] repeat=%d gap=%luus loss=%.1f%%\n", _nextRepeat, (unsigned long)_nextGap, loss * 100);
+    bool passes = loss <= _maxLoss;
+
+    switch (_phase) {
+        case TUNE_START:
+            if (!passes) {
+                Serial.println("[Tune] Losses at the starting point, keeping it");
+                _phase = TUNE_DONE;
+                return;
+            }
+            _phase = TUNE_REPEAT;
+            break;
+        case TUNE_REPEAT:
+            if (passes) {
+                _repeat = _nextRepeat;
+            } else {
+                _phase = TUNE_GAP;
+            }
+            break;
+        case TUNE_GAP:
+            if (passes) {
+                _gap = _nextGap;
+            } else {
+                Finish();
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+//=================================================================================================
+// Finish
+//=================================================================================================
+void RfTuner::Finish() {
+    _result.repeat = _repeat + TUNE_REPEAT_MARGIN > _maxRepeat ? _maxRepeat : _repeat + TUNE_REPEAT_MARGIN;
+    _result.gap = _gap;
+    _result.ok = true;
+    _phase = TUNE_DONE;
+    Serial.printf("[Tune] Lowest passing: repeat=%d gap=%luus, using repeat=%d after %d trials\n", _repeat,
+                  (unsigned long)_gap, _result.repeat, _trials);
+}
+
+//=================================================================================================
+// Load / Save / Clear
+//=================================================================================================
+bool RfTuner::Load(Result& result) {
+    Preferences prefs;
+    if (!prefs.begin("quntis_rf", true)) {
+        return false;
+    }
+    result.repeat = prefs.getUChar("repeat", 0);
+    result.gap = prefs.getUInt("gap", 0);
+    result.loss = prefs.getFloat("loss", TUNE_LOSS_UNKNOWN);
+    prefs.end();
+
+    result.ok = result.repeat > 0;
+    return result.ok;
+}
+
+void RfTuner::Save(const Result& result) {
+    Preferences prefs;
+    prefs.begin("quntis_rf", false);
+    prefs.putUChar("repeat", result.repeat);
+    prefs.putUInt("gap", result.gap);
+    prefs.putFloat("loss", result.loss);
+    prefs.end();
+}
+
+void RfTuner::Clear() {
+    Preferences prefs;
+    prefs.begin("quntis_rf", false);
+    prefs.clear();
+    prefs.end();
+}
@@ -0,0 +1,70 @@
+//
+//	RfTuner.h
+//
+//	    Finds the lowest repeat count and repeat gap that still get every command
+//	    through, and keeps the result in NVS
+//
+//=================================================================================================
+#include <Arduino.h>
+
+#include <functional>
+
+#define TUNE_MIN_GAP_US 500   // lowest repeat gap tried
+#define TUNE_REPEAT_MARGIN 1  // extra frames on top of the lowest passing repeat count
+#define TUNE_LOSS_UNKNOWN -1.0f
+
+//=================================================================================================
+//	RfTuner
+//=================================================================================================
+#ifndef RFTUNER_H
+#define RFTUNER_H
+
+class RfTuner {
+   public:
+    // Sends a batch of commands with the given settings and returns the fraction that was
+    // lost (0..1). On the device that's the monitor receiver, on the host a simulated channel.
+    typedef std::function<float(uint8_t repeat, uint32_t gapUs)> Trial;
+
+    struct Result {
+        uint8_t repeat;
+        uint32_t gap;
+        float loss;  // frame loss measured at the result, filled in by the caller
+        bool ok;     // false when even the starting point lost commands
+    };
+
+    RfTuner(Trial trial = nullptr, float maxLoss = 0) : _trial(trial), _maxLoss(maxLoss) {}
+
+    // Lowers the repeat count first, then halves the gap, both only while the trial passes
+    Result Tune(uint8_t maxRepeat, uint32_t maxGap);
+    uint16_t GetTrialCount() { return _trials; }
+
+    // The same search one trial at a time, for a caller that runs the trials from loop(): Start(),
+    // then while Next() hands out settings run a trial with them and Report() its loss
+    void Start(uint8_t maxRepeat, uint32_t maxGap);
+    bool Next(uint8_t& repeat, uint32_t& gap);
+    void Report(float loss);
+    const Result& GetResult() { return _result; }
+
+    static bool Load(Result& result);
+    static void Save(const Result& result);
+    static void Clear();
+
+   private:
+    enum Phase { TUNE_START, TUNE_REPEAT, TUNE_GAP, TUNE_DONE };
+
+    void Finish();
+
+    Trial _trial;
+    float _maxLoss;
+    uint16_t _trials = 0;
+
+    Phase _phase = TUNE_DONE;
+    uint8_t _maxRepeat = 0;
+    uint8_t _repeat = 0;  // lowest passing so far
+    uint32_t _gap = 0;
+    uint8_t _nextRepeat = 0;  // handed out by Next(), judged by Report()
+    uint32_t _nextGap = 0;
+    Result _result = {};
+};
+
+#endif
@@ -0,0 +1,82 @@
+#include <StepJournal.h>
+#include <esp_attr.h>
+#include <esp_system.h>
+#include <stddef.h>
+
+#define JOURNAL_MAGIC 0x514A  // "QJ"
+
+// Kept over every reset but power-on, not initialized at boot
+RTC_NOINIT_ATTR static StepJournal::Record journal[JOURNAL_SIZE];
+
+uint32_t StepJournal::_appends = 0;
+
+//=================================================================================================
+// Restore
+//=================================================================================================
+bool StepJournal::Restore(Record& record) {
+    if (esp_reset_reason() == ESP_RST_POWERON) {
+        Clear();
+        return false;
+    }
+    return Newest(record);
+}
+
+bool StepJournal::Newest(Record& record) {
+    bool found = false;
+    for (int i = 0; i < JOURNAL_SIZE; i++) {
+        const Record& r = journal[i];
+        if (r.magic != JOURNAL_MAGIC || r.crc != Crc(r)) {
+            continue;
+        }
+        if (!found || (int16_t)(r.seq - record.seq) > 0) {
+            record = r;
+            found = true;
+        }
+    }
+    return found;
+}
+
+//=================================================================================================
+// Append
+//=================================================================================================
+void StepJournal::Append(bool power, int brightness, int color, int brightnessTarget, int colorTarget, uint8_t index) {
+    Record last;
+    bool hasLast = Newest(last);
+
+    Record r;
+    r.magic = JOURNAL_MAGIC;
+    r.seq = hasLast ? last.seq + 1 : 0;
+    r.power = power;
+    r.brightness = brightness;
+    r.color = color;
+    r.brightnessTarget = brightnessTarget;
+    r.colorTarget = colorTarget;
+    r.index = index;
+    if (hasLast && last.power == r.power && last.brightness == r.brightness && last.color == r.color &&
+        last.brightnessTarget == r.brightnessTarget && last.colorTarget == r.colorTarget && last.index == r.index) {
+        return;
+    }
+    r.crc = Crc(r);
+
+    journal[r.seq % JOURNAL_SIZE] = r;
+    _appends++;
+}
+
+void StepJournal::Clear() {
+    memset(journal, 0, sizeof(journal));
+}
+
+//=================================================================================================
+// Crc: CRC-8 (poly 0x07) over everything before the crc field
+//=================================================================================================
+uint8_t StepJournal::Crc(const Record& record) {
+    const uint8_t* data = (const uint8_t*)&record;
+    uint8_t crc = 0;
+    for (size_t i = 0; i < offsetof(Record, crc); i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+        }
+    }
+    return crc;
+}
@@ -0,0 +1,50 @@
+//
+//	StepJournal.h
+//
+//	    Ring of state records in RTC memory, written after every RF command, so a reset in the
+//	    middle of a ramp comes back knowing the step the lamp is at and the packet index it saw
+//
+//=================================================================================================
+#include <Arduino.h>
+
+#define JOURNAL_SIZE 8  // records in the ring, the newest valid one wins
+
+//=================================================================================================
+//	StepJournal
+//=================================================================================================
+#ifndef STEPJOURNAL_H
+#define STEPJOURNAL_H
+
+class StepJournal {
+   public:
+    struct Record {
+        uint16_t magic;
+        uint16_t seq;
+        uint8_t power;
+        uint8_t brightness;        // step the lamp is at
+        uint8_t color;
+        uint8_t brightnessTarget;  // step it was heading for
+        uint8_t colorTarget;
+        uint8_t index;             // next packet index
+        uint8_t crc;
+    };
+
+    // Newest record that is intact, false after a power-on (RTC memory is garbage then) or
+    // when nothing was written yet
+    static bool Restore(Record& record);
+
+    // Writes the next slot, the one before stays valid until this one is complete. Records
+    // equal to the newest one are skipped.
+    static void Append(bool power, int brightness, int color, int brightnessTarget, int colorTarget, uint8_t index);
+    static void Clear();
+
+    static uint32_t GetAppendCount() { return _appends; }
+
+   private:
+    static bool Newest(Record& record);
+    static uint8_t Crc(const Record& record);
+
+    static uint32_t _appends;
+};
+
+#endif
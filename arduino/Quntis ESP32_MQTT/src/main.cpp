@@ -17,6 +17,8 @@
 #include <WiFi.h>
 
 #include "QuntisControl.h"
+#include "QuntisLamp.h"
+#include "RfTuner.h"
 #include "config.h"
 #include "mqtt_manager.h"
 #include "web_ui.h"
@@ -25,6 +27,15 @@ QuntisControl quntis;
 MqttManager* mqttManager = nullptr;
 WebUI* webUI = nullptr;
 
+#ifdef MONITOR_CE_PIN
+XN297 monitor(MONITOR_CE_PIN, MONITOR_CSN_PIN);
+int tuneLamp = -1;
+
+// Test lamp for tuning, nothing listens on this address
+static const byte tuneAddress[ADDRESS_LENGTH] = {0x54, 0x55, 0x4E, 0x45, 0x01};
+static const byte tunePayload[PAYLOAD_LENGTH] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+#endif
+
 void setupWiFi() {
     WiFi.mode(WIFI_STA);
     WiFi.setHostname(WIFI_HOSTNAME);
@@ -60,6 +71,153 @@ void setupMDNS() {
     }
 }
 
+//=================================================================================================
+// Monitor receiver: optional second NRF24L01 that hears our own frames, used for tuning
+//=================================================================================================
+#define TUNE_COMMANDS 50
+
+void setupMonitor() {
+#ifdef MONITOR_CE_PIN
+    if (!monitor.begin()) {
+        Serial.println("✗ Monitor NRF24L01 not found, tuning disabled");
+        return;
+    }
+    monitor.setChannel(2);
+    monitor.setDataRate(RF24_1MBPS);
+    monitor.setAutoAck(false);
+    monitor.disableCRC();
+    monitor.setPayloadSize(ADDRESS_LENGTH + PAYLOAD_LENGTH + 2);
+    monitor.XN297_SetRXAddr(tuneAddress, ADDRESS_LENGTH);
+    monitor.startListening();
+
+    tuneLamp = quntis.AddLamp(tuneAddress, tunePayload);
+    Serial.println("✓ Monitor receiver ready, send 't' to tune");
+#endif
+}
+
+//=================================================================================================
+// Tuning: RfTuner's trials run from loop(), each one alternating DIM up/down to the test lamp one
+// burst at a time while the monitor is drained. The monitor's RX FIFO holds 3 frames, so loop()
+// only sleeps 1 ms while a trial is on air.
+//=================================================================================================
+enum TuneState { TUNE_IDLE, TUNE_SEARCH, TUNE_LOSS };
+
+TuneState tuneState = TUNE_IDLE;
+
+#ifdef MONITOR_CE_PIN
+RfTuner tuner;
+RfTuner::Result tuneResult;
+uint8_t tuneRepeat = TX_REPEAT;  // in use before tuning, kept when it fails
+uint32_t tuneGap = RF_REPEAT_GAP_US;
+
+QuntisLamp trialLamp(tuneAddress, tunePayload, TUNE_COMMANDS, TUNE_COMMANDS);
+int trialSent = 0;
+unsigned long trialStepMs = 0;
+uint32_t trialFramesSent = 0;
+uint32_t trialFramesHeard = 0;
+
+void startTrial(uint8_t repeat, uint32_t gap) {
+    quntis.SetRepeatCount(repeat);
+    quntis.SetRepeatGap(gap);
+    trialLamp = QuntisLamp(tuneAddress, tunePayload, TUNE_COMMANDS, TUNE_COMMANDS);
+    trialLamp.Reset(true, TUNE_COMMANDS / 2, 0);
+    monitor.flush_rx();
+    trialFramesSent = TUNE_COMMANDS * repeat;
+    trialFramesHeard = 0;
+    trialSent = 0;
+    trialStepMs = millis();
+}
+
+// True once all commands of the trial are on air and the monitor had its chance to hear them
+bool trialDone() {
+    uint8_t msg[PAYLOAD_LENGTH];
+    while (monitor.available()) {
+        if (monitor.XN297_ReadPayload(msg, PAYLOAD_LENGTH)) {
+            trialFramesHeard++;
+            trialLamp.Apply(msg);
+        }
+    }
+    if (!quntis.IsTxIdle() || millis() - trialStepMs < 2) {
+        return false;
+    }
+    if (trialSent == TUNE_COMMANDS) {
+        return true;
+    }
+    if (quntis.Dim(trialSent & 1, true, tuneLamp)) {
+        trialSent++;
+        trialStepMs = millis();
+    }
+    return false;
+}
+
+float trialLoss() {
+    return 1.0f - (float)trialLamp.GetStats().commands / TUNE_COMMANDS;
+}
+#endif
+
+void tuneRf() {
+#ifdef MONITOR_CE_PIN
+    if (tuneLamp < 0) {
+        Serial.println("[Serial] No monitor receiver, tuning disabled");
+        return;
+    }
+    if (tuneState != TUNE_IDLE) {
+        Serial.println("[Serial] Tuning already running");
+        return;
+    }
+    tuneRepeat = quntis.GetRepeatCount();
+    tuneGap = quntis.GetRepeatGap();
+
+    Serial.printf("[Serial] Tuning from repeat=%d gap=%luus, %d commands per trial\n", TX_REPEAT,
+                  (unsigned long)RF_REPEAT_GAP_US, TUNE_COMMANDS);
+    uint8_t repeat;
+    uint32_t gap;
+    tuner.Start(TX_REPEAT, RF_REPEAT_GAP_US);
+    tuner.Next(repeat, gap);
+    startTrial(repeat, gap);
+    tuneState = TUNE_SEARCH;
+#else
+    Serial.println("[Serial] Tuning needs a monitor receiver, see MONITOR_CE_PIN in config.h");
+#endif
+}
+
+void tuneRfLoop() {
+#ifdef MONITOR_CE_PIN
+    if (tuneState == TUNE_IDLE || !trialDone()) {
+        return;
+    }
+
+    if (tuneState == TUNE_SEARCH) {
+        uint8_t repeat;
+        uint32_t gap;
+        tuner.Report(trialLoss());
+        if (tuner.Next(repeat, gap)) {
+            startTrial(repeat, gap);
+            return;
+        }
+        tuneResult = tuner.GetResult();
+        if (tuneResult.ok) {
+            // Frame loss at the chosen settings sizes the intermediate steps of a ramp
+            startTrial(tuneResult.repeat, tuneResult.gap);
+            tuneState = TUNE_LOSS;
+            return;
+        }
+    } else {
+        tuneResult.loss = trialFramesHeard >= trialFramesSent ? 0.0f : 1.0f - (float)trialFramesHeard / trialFramesSent;
+        quntis.SetLossEstimate(tuneResult.loss);
+        RfTuner::Save(tuneResult);
+        tuneRepeat = tuneResult.repeat;
+        tuneGap = tuneResult.gap;
+    }
+
+    tuneState = TUNE_IDLE;
+    quntis.SetRepeatCount(tuneRepeat);
+    quntis.SetRepeatGap(tuneGap);
+    Serial.printf("[Serial] Using repeat=%d gap=%luus, frame loss %.1f%% -> %d copies per intermediate step\n",
+                  tuneRepeat, (unsigned long)tuneGap, quntis.GetLossEstimate() * 100, quntis.GetStepRepeat());
+#endif
+}
+
 void setup() {
     Serial.begin(115200);
     delay(1000);
@@ -78,8 +236,26 @@ void setup() {
         while (1) delay(1000);
     }
 
+    quntis.SetRepeatGap(RF_REPEAT_GAP_US);
+    quntis.SetHoldRate(RF_HOLD_STEPS_PER_SEC);
+    quntis.SetLossEstimate(RF_FRAME_LOSS);
+    quntis.SetCarrierSense(RF_CARRIER_SENSE);
+    quntis.SetWifiAlign(RF_WIFI_ALIGN);
+
+    RfTuner::Result tuned;
+    if (RfTuner::Load(tuned)) {
+        quntis.SetRepeatCount(tuned.repeat);
+        quntis.SetRepeatGap(tuned.gap);
+        if (tuned.loss >= 0) {
+            quntis.SetLossEstimate(tuned.loss);
+        }
+        Serial.printf("Tuned RF settings: repeat=%d gap=%luus loss=%.1f%%\n", tuned.repeat, (unsigned long)tuned.gap,
+                      quntis.GetLossEstimate() * 100);
+    }
     Serial.println("✓ RF24 initialized");
 
+    setupMonitor();
+
     setupWiFi();
     setupMDNS();
 
@@ -100,9 +276,125 @@ void setup() {
     Serial.println("Serial: Send '?' for command help\n");
 }
 
+//=================================================================================================
+// Hold calibration: ramp up from the minimum for a fixed time, then single steps back down until
+// DIM DOWN on the original remote (or any key on serial) says the lamp is at minimum again. Runs
+// from loop(). With a monitor receiver only the steps it heard count, a lost one didn't move the lamp.
+//=================================================================================================
+#define HOLD_CAL_MS 1000
+#define HOLD_CAL_STEP_MS 400
+
+enum HoldCalState { HOLD_CAL_IDLE, HOLD_CAL_TO_MIN, HOLD_CAL_HOLD, HOLD_CAL_STEP_DOWN };
+
+HoldCalState holdCalState = HOLD_CAL_IDLE;
+int holdCalSteps = 0;           // steps queued in the current phase
+unsigned long holdCalStepMs = 0;
+uint32_t holdCalRxFrames = 0;   // frames heard from the remote when the steps down began
+
+#ifdef MONITOR_CE_PIN
+QuntisLamp holdCalHeard(quntis.GetAddress(), quntis.GetPayload(), BRIGHTNESS_STEPS, COLOR_TEMP_STEPS);
+#endif
+
+void calibrateHold() {
+    if (holdCalState != HOLD_CAL_IDLE || tuneState != TUNE_IDLE) {
+        Serial.println("[Serial] Hold calibration or tuning already running");
+        return;
+    }
+#if RF_LISTEN_REMOTE
+    Serial.println("[Serial] Hold calibration, the lamp must be on. Dimming to minimum...");
+    holdCalSteps = 0;
+    holdCalState = HOLD_CAL_TO_MIN;
+#else
+    Serial.println("[Serial] Hold calibration waits for the original remote, see RF_LISTEN_REMOTE in config.h");
+#endif
+}
+
+void calibrateHoldDone() {
+    int steps = holdCalSteps;
+#ifdef MONITOR_CE_PIN
+    if (tuneLamp >= 0) {
+        // The remote's DIM DOWN is heard as well
+        if ((int)holdCalHeard.GetStats().commands < steps) {
+            steps = holdCalHeard.GetStats().commands;
+        }
+        monitor.XN297_SetRXAddr(tuneAddress, ADDRESS_LENGTH);
+    }
+#endif
+    holdCalState = HOLD_CAL_IDLE;
+
+    float rate = steps * 1000.0f / HOLD_CAL_MS;
+    quntis.SetHoldRate(rate);
+    Serial.printf("[Serial] Hold: %d steps in %d ms = %.1f steps/s, put it in RF_HOLD_STEPS_PER_SEC to keep it\n",
+                  steps, HOLD_CAL_MS, rate);
+    if (mqttManager) {
+        mqttManager->resyncBrightness(0);
+    }
+    Serial.println("[Serial] Lamp is at minimum brightness now, tracked brightness reset to it");
+}
+
+void calibrateHoldLoop() {
+    switch (holdCalState) {
+        case HOLD_CAL_TO_MIN:
+            // More steps than the RF queue holds, the rest go out on later loops
+            while (holdCalSteps < BRIGHTNESS_STEPS && quntis.Dim(false, true)) {
+                holdCalSteps++;
+            }
+            if (holdCalSteps == BRIGHTNESS_STEPS && quntis.IsTxIdle()) {
+                Serial.printf("[Serial] Holding DIM UP for %d ms\n", HOLD_CAL_MS);
+                quntis.Ramp(QUNTIS_CMD_DIM, true, HOLD_CAL_MS);
+                holdCalState = HOLD_CAL_HOLD;
+            }
+            break;
+
+        case HOLD_CAL_HOLD:
+            if (!quntis.IsTxIdle()) {
+                break;
+            }
+            Serial.println("[Serial] Stepping down, press DIM DOWN on the remote as soon as the lamp is at minimum");
+#ifdef MONITOR_CE_PIN
+            if (tuneLamp >= 0) {
+                monitor.XN297_SetRXAddr(quntis.GetAddress(), ADDRESS_LENGTH);
+                monitor.flush_rx();
+                holdCalHeard = QuntisLamp(quntis.GetAddress(), quntis.GetPayload(), BRIGHTNESS_STEPS, COLOR_TEMP_STEPS);
+                holdCalHeard.Reset(true, BRIGHTNESS_STEPS, 0);
+            }
+#endif
+            holdCalSteps = 0;
+            holdCalStepMs = millis() - HOLD_CAL_STEP_MS;
+            holdCalRxFrames = quntis.GetRxFrameCount();
+            holdCalState = HOLD_CAL_STEP_DOWN;
+            break;
+
+        case HOLD_CAL_STEP_DOWN: {
+#ifdef MONITOR_CE_PIN
+            uint8_t msg[PAYLOAD_LENGTH];
+            while (tuneLamp >= 0 && monitor.available()) {
+                if (monitor.XN297_ReadPayload(msg, PAYLOAD_LENGTH)) {
+                    holdCalHeard.Apply(msg);
+                }
+            }
+#endif
+            if (quntis.GetRxFrameCount() != holdCalRxFrames || holdCalSteps == BRIGHTNESS_STEPS) {
+                calibrateHoldDone();
+            } else if (millis() - holdCalStepMs >= HOLD_CAL_STEP_MS && quntis.Dim(false, true)) {
+                holdCalSteps++;
+                holdCalStepMs = millis();
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
 void handleSerialCommands() {
     if (Serial.available()) {
         char c = Serial.read();
+        if (holdCalState == HOLD_CAL_STEP_DOWN) {
+            calibrateHoldDone();  // any key instead of the remote
+            return;
+        }
         switch (c) {
             case 'o':
                 Serial.println("[Serial] Sending ON/OFF");
@@ -127,7 +419,42 @@ void handleSerialCommands() {
             case 'p':
                 Serial.println("[Serial] Packet count:");
                 quntis.ShowNrOfPacketsSend();
+                if (mqttManager) {
+                    mqttManager->showStats();
+                }
+                break;
+            case 'j':
+                quntis.ShowJitterHistogram();
+                break;
+            case 'h':
+                calibrateHold();
+                break;
+            case 't':
+                if (holdCalState != HOLD_CAL_IDLE) {
+                    Serial.println("[Serial] Hold calibration running, tune after it");
+                    break;
+                }
+                tuneRf();
+                break;
+            case 'u':
+                RfTuner::Clear();
+                quntis.SetRepeatCount(TX_REPEAT);
+                quntis.SetRepeatGap(RF_REPEAT_GAP_US);
+                quntis.SetLossEstimate(RF_FRAME_LOSS);
+                Serial.printf("[Serial] Tuning cleared, repeat=%d gap=%luus\n", TX_REPEAT, (unsigned long)RF_REPEAT_GAP_US);
+                break;
+            case 's':
+                quntis.SetCarrierSense(!quntis.GetCarrierSense());
+                Serial.printf("[Serial] Carrier sense %s\n", quntis.GetCarrierSense() ? "on" : "off");
+                break;
+            case '<':
+            case '>': {
+                uint32_t gap = quntis.GetRepeatGap();
+                gap = (c == '>') ? gap + 500 : (gap >= 500 ? gap - 500 : 0);
+                quntis.SetRepeatGap(gap);
+                Serial.printf("[Serial] Repeat gap: %luus\n", (unsigned long)gap);
                 break;
+            }
             case '?':
                 Serial.println("\n[Serial Commands]");
                 Serial.println("  o  = On/Off toggle");
@@ -135,7 +462,14 @@ void handleSerialCommands() {
                 Serial.println("  -  = Dim down");
                 Serial.println("  w  = Color warmer");
                 Serial.println("  c  = Color colder");
-                Serial.println("  p  = Show packet count");
+                Serial.println("  p  = Show packet count and command stats");
+                Serial.println("  j  = Show repeat gap jitter");
+                Serial.println("  h  = Calibrate hold ramp rate (with the original remote)");
+                Serial.println("  t  = Tune repeat count/gap with the monitor receiver");
+                Serial.println("  u  = Forget tuned repeat count/gap");
+                Serial.println("  s  = Toggle carrier sense before bursts");
+                Serial.println("  <  = Repeat gap -500us");
+                Serial.println("  >  = Repeat gap +500us");
                 Serial.println("  ?  = Show this help");
                 break;
             default:
@@ -159,5 +493,7 @@ void loop() {
     }
 
     handleSerialCommands();
-    delay(10);
+    calibrateHoldLoop();
+    tuneRfLoop();
+    delay(tuneState == TUNE_IDLE ? 10 : 1);  // a trial drains the monitor's RX FIFO, see tuneRfLoop()
 }
@@ -1,8 +1,39 @@
 #include "mqtt_manager.h"
 
+#include <esp_system.h>
+
+#include "StepJournal.h"
+
+// Moves this far or more use a held button when the hold rate is known
+#define HOLD_MIN_STEPS 10
+// Share of a hold's steps the lamp may be off by, the measured rate isn't exact. The error adds up
+// per axis until a hold into an end stop runs it out (see stepAxis).
+#define HOLD_RATE_ERROR 0.1f
+
+// Commands this close together merge (a slider drag sends a burst of them), but none waits longer
+// than COMMAND_MAX_WAIT_MS for the burst to end
+#define COMMAND_SETTLE_MS 150
+#define COMMAND_MAX_WAIT_MS 1000
+
+// The state is saved this long after its last change, a slider drag or a run of remote presses
+// is one flash write instead of one per step
+#define NVS_SAVE_DELAY_MS 2000
+#define NVS_STATE_VERSION 1
+
+// One putBytes() is one NVS commit, three keys were three
+struct __attribute__((packed)) SavedState {
+    uint8_t version;
+    uint8_t power;
+    uint8_t brightness;  // 0-100
+    uint16_t colorTemp;  // mireds
+};
+
 static MqttManager* mqtt_instance = nullptr;
 
-MqttManager::MqttManager(QuntisControl* controller) : _mqtt(_wifi_client), _controller(controller) {
+MqttManager::MqttManager(QuntisControl* controller)
+    : _mqtt(_wifi_client),
+      _controller(controller),
+      _remote(controller->GetAddress(), controller->GetPayload(), BRIGHTNESS_STEPS, COLOR_TEMP_STEPS) {
     mqtt_instance = this;
 
     _config_topic = String(MQTT_DISCOVERY_PREFIX) + "/light/" + MQTT_DEVICE_ID + "/config";
@@ -14,6 +45,25 @@ MqttManager::MqttManager(QuntisControl* controller) : _mqtt(_wifi_client), _cont
 void MqttManager::begin() {
     loadState();
 
+    // Assume the lamp is where we left it
+    _brightness_step = _brightness_target = (_brightness * BRIGHTNESS_STEPS) / 100;
+    _color_step = _color_target = (miredsToPercent(_color_temp) * COLOR_TEMP_STEPS) / 100;
+
+    // After a crash or watchdog reset the journal knows better: NVS lags a debounce behind, and
+    // a reset halfway through a ramp left the lamp somewhere between the saved state and the target
+    restoreJournal();
+
+    // esp_restart() (OTA, reboot from the web UI) runs these, a brownout reset doesn't leave time
+    esp_register_shutdown_handler([]() {
+        if (mqtt_instance) {
+            mqtt_instance->flushState();
+        }
+    });
+
+#if RF_LISTEN_REMOTE
+    _controller->SetRxCallback([this](const uint8_t* raw, uint8_t len) { onRemoteFrame(raw, len); });
+#endif
+
     _mqtt.setServer(MQTT_BROKER, MQTT_PORT);
     _mqtt.setCallback(messageCallback);
     _mqtt.setBufferSize(1024);  // Default is 256 (too small)
@@ -27,6 +77,18 @@ void MqttManager::loop() {
     }
 
     _mqtt.loop();
+    _controller->NotifyWifiIdle();  // network just serviced, a good moment for bursts
+    _controller->PollRx();
+
+    unsigned long now = millis();
+    if (_command.pending && (now - _command.lastMs >= COMMAND_SETTLE_MS || now - _command.firstMs >= COMMAND_MAX_WAIT_MS)) {
+        applyCommand();
+    }
+    processSteps();
+
+    if (_dirty && now - _dirty_ms >= NVS_SAVE_DELAY_MS) {
+        saveState();
+    }
 }
 
 bool MqttManager::isConnected() {
@@ -74,6 +136,7 @@ void MqttManager::publishHomeAssistantDiscovery() {
     doc["payload_off"] = "OFF";
     doc["brightness"] = true;
     doc["brightness_scale"] = 100;
+    doc["transition"] = true;
     doc["min_mireds"] = 153;  // Coldest (6500K)
     doc["max_mireds"] = 500;  // Warmest (2000K)
 
@@ -97,17 +160,22 @@ void MqttManager::publishHomeAssistantDiscovery() {
 }
 
 void MqttManager::publishState() {
+    publishState(_brightness, _color_temp);
+}
+
+void MqttManager::publishState(int brightness, int colorTemp) {
     JsonDocument doc;
 
     doc["state"] = _power_state ? "ON" : "OFF";
-    doc["brightness"] = _brightness;
-    doc["color_temp"] = _color_temp;
+    doc["brightness"] = brightness;
+    doc["color_temp"] = colorTemp;
     doc["color_mode"] = "color_temp";
 
     String payload;
     serializeJson(doc, payload);
 
     bool ok = _mqtt.publish(_state_topic.c_str(), payload.c_str());
+    _last_publish_ms = millis();
     Serial.printf("Published state (%s): %s\n", ok ? "OK" : "FAIL", payload.c_str());
 }
 
@@ -134,83 +202,312 @@ void MqttManager::handleCommand(const char* json, bool colorTempInMireds) {
         return;
     }
 
+    _coalesceStats.commands++;
+    if (_command.pending) {
+        _coalesceStats.publishesSaved++;
+    } else {
+        _command = {};
+        _command.pending = true;
+        _command.firstMs = millis();
+    }
+    _command.lastMs = millis();
+    _command.merged++;
+
     if (!doc["state"].isNull()) {
         const char* state = doc["state"];
-        bool new_power = (strcmp(state, "ON") == 0);
-        setPower(new_power);
+        if (_command.hasPower) {
+            _coalesceStats.togglesSaved++;
+        }
+        _command.hasPower = true;
+        _command.power = (strcmp(state, "ON") == 0);
     }
 
+    // Only the newest target counts, processSteps() heads there from wherever the lamp is. The
+    // mailbox counts each move from the target before it, as if every command ran to its end.
+    int brightnessTarget = _brightness_target;
+    int colorTarget = _color_target;
     if (!doc["brightness"].isNull()) {
         int new_brightness = doc["brightness"];
+        int from = _brightness_target;
         setBrightness(new_brightness);
+        _command.steps += abs(_brightness_target - from);
     }
 
     if (!doc["color_temp"].isNull()) {
         int value = doc["color_temp"];
         int percent = colorTempInMireds ? miredsToPercent(value) : value;
+        int from = _color_target;
         setColorTemp(percent);
+        _command.steps += abs(_color_target - from);
     }
 
+    // HA sends the transition in seconds, an axis the command moves without one goes out at full speed.
+    // An axis it leaves alone keeps the pace of the transition it is in (HA repeats the state with
+    // every change).
+    bool hasTransition = !doc["transition"].isNull();
+    float transition = hasTransition ? doc["transition"].as<float>() : 0;
+    if (hasTransition || _brightness_target != brightnessTarget) {
+        startTransition(_brightness_pace, _brightness_step, transition);
+    }
+    if (hasTransition || _color_target != colorTarget) {
+        startTransition(_color_pace, _color_step, transition);
+    }
+    if (transition > 0) {
+        Serial.printf("[MQTT] Transition over %lums: brightness step %d->%d, color step %d->%d\n",
+                      (unsigned long)(transition * 1000), _brightness_step, _brightness_target, _color_step, _color_target);
+    }
+    journal();  // a reset before the first step still knows where the lamp was heading
+
+    _last_plan = planCommand();
+    Serial.printf("[MQTT] Plan: %s, DIM %+d, COLOR %+d\n", _last_plan.toggle ? "toggle power" : "no toggle",
+                  _last_plan.dimSteps, _last_plan.colorSteps);
+}
+
+// Steps to an off lamp are lost, they stay in the targets until it is on again
+MqttManager::Plan MqttManager::planCommand() {
+    Plan plan = {};
+    bool power = getPowerState();
+    plan.toggle = power != _power_state;
+    if (power) {
+        plan.dimSteps = _brightness_target - _brightness_step;
+        plan.colorSteps = _color_target - _color_step;
+    }
+    return plan;
+}
+
+// Once commands stop arriving: the power change they ended on, one NVS write and one state publish
+void MqttManager::applyCommand() {
+    Command command = _command;
+    _command = {};
+
+    if (command.hasPower && !setPower(command.power)) {
+        _command = command;  // the next loop() tries again
+        return;
+    }
+    markDirty();
     publishState();
+
+    // Steps still to go count as net, the ones taken since the first command are spent either way
+    _coalesceStats.applied++;
+    if (command.merged > 1) {
+        int net = abs(_brightness_target - _brightness_step) + abs(_color_target - _color_step);
+        int saved = command.steps > net ? command.steps - net : 0;
+        _coalesceStats.stepsSaved += saved;
+        Serial.printf("[MQTT] Merged %d commands over %lums, %d steps saved\n", command.merged,
+                      command.lastMs - command.firstMs, saved);
+    }
+}
+
+void MqttManager::showStats() {
+    const CoalesceStats& cs = _coalesceStats;
+    unsigned long uptime = millis();
+    Serial.printf("Commands: %lu received, %lu applied, merging saved %lu steps, %lu power toggles, %lu publishes, "
+                  "%lu toggles skipped as already in state\n",
+                  (unsigned long)cs.commands, (unsigned long)cs.applied, (unsigned long)cs.stepsSaved,
+                  (unsigned long)cs.togglesSaved, (unsigned long)cs.publishesSaved, (unsigned long)cs.togglesSkipped);
+    Serial.printf("NVS: %lu commits (%.1f per hour), %lu unchanged saves skipped%s\n", (unsigned long)_nvs_commits,
+                  uptime ? _nvs_commits * 3600000.0f / uptime : 0.0f, (unsigned long)_nvs_skipped,
+                  _dirty ? ", change pending" : "");
+    Serial.printf("Step journal: %lu records in RTC memory\n", (unsigned long)StepJournal::GetAppendCount());
+    Serial.printf("Hold error: brightness +-%.1f steps, color +-%.1f steps\n", _brightness_hold_error, _color_hold_error);
 }
 
-void MqttManager::setPower(bool on) {
+// The lamp is known to be at this brightness step (after a hold calibration it's at 0), the tracked
+// state and HA follow without sending anything
+void MqttManager::resyncBrightness(int step) {
+    _brightness_step = _brightness_target = constrain(step, 0, BRIGHTNESS_STEPS);
+    _brightness_pace = {0, 0, _brightness_step};
+    _brightness = (_brightness_step * 100) / BRIGHTNESS_STEPS;
+    _brightness_hold_error = 0;
+    Serial.printf("[MQTT] Resync: brightness step %d\n", _brightness_step);
+
+    journal();
+    markDirty();
+    publishState();
+}
+
+// Steps already taken stay, the rest of the way to the axis' target is spread over the transition
+void MqttManager::startTransition(Pace& pace, int step, float seconds) {
+    pace.ms = seconds > 0 ? (unsigned long)(seconds * 1000) : 0;
+    pace.startMs = millis();
+    pace.from = step;
+}
+
+// Where an axis should be by now: step k of n is due once k/n of its transition has passed
+int MqttManager::pacedTarget(const Pace& pace, int target) {
+    unsigned long elapsed = millis() - pace.startMs;
+    if (pace.ms == 0 || elapsed >= pace.ms) {
+        return target;
+    }
+    return pace.from + (int)((long long)(target - pace.from) * elapsed / pace.ms);
+}
+
+// Steps the lamp got, where they were heading and the index they used, kept over a reset
+void MqttManager::journal() {
+    StepJournal::Append(_power_state, _brightness_step, _color_step, _brightness_target, _color_target,
+                        _controller->GetIndex());
+}
+
+void MqttManager::restoreJournal() {
+    StepJournal::Record record;
+    if (!StepJournal::Restore(record)) {
+        return;
+    }
+
+    _power_state = record.power;
+    _brightness_step = constrain(record.brightness, 0, BRIGHTNESS_STEPS);
+    _color_step = constrain(record.color, 0, COLOR_TEMP_STEPS);
+    _brightness_pace = {0, 0, _brightness_step};
+    _color_pace = {0, 0, _color_step};
+
+    // Targets the saved percent doesn't round to came from a command NVS hadn't caught up with
+    int brightnessTarget = constrain(record.brightnessTarget, 0, BRIGHTNESS_STEPS);
+    int colorTarget = constrain(record.colorTarget, 0, COLOR_TEMP_STEPS);
+    if (brightnessTarget != _brightness_target) {
+        _brightness_target = brightnessTarget;
+        _brightness = (_brightness_target * 100) / BRIGHTNESS_STEPS;
+    }
+    if (colorTarget != _color_target) {
+        _color_target = colorTarget;
+        _color_temp = percentToMireds((_color_target * 100) / COLOR_TEMP_STEPS);
+    }
+
+    // The last command may have gone out after its record was written, skip its index as well
+    _controller->SetIndex(record.index + 1);
+
+    Serial.printf("[MQTT] Restored from journal: power=%s brightness step %d->%d, color step %d->%d, index %d\n",
+                  _power_state ? "ON" : "OFF", _brightness_step, _brightness_target, _color_step, _color_target,
+                  record.index + 1);
+
+    // processSteps() finishes an interrupted ramp, NVS catches up once it is done
+    markDirty();
+}
+
+bool MqttManager::setPower(bool on) {
     Serial.printf("[MQTT] setPower(%s) current_state=%s\n", on ? "ON" : "OFF", _power_state ? "ON" : "OFF");
 
-    _controller->OnOff();
+    // OnOff() toggles, HA repeats "state":"ON" with every brightness change
+    if (on == _power_state) {
+        _coalesceStats.togglesSkipped++;
+        return true;
+    }
+    if (!_controller->OnOff()) {
+        return false;
+    }
     _power_state = on;
-
-    saveState();
+    journal();
+    return true;
 }
 
 void MqttManager::setBrightness(int value) {
     value = constrain(value, 0, 100);
-    Serial.printf("[MQTT] setBrightness(%d) current=%d diff=%d\n", value, _brightness, value - _brightness);
+    _brightness_target = (value * BRIGHTNESS_STEPS) / 100;
+    Serial.printf("[MQTT] setBrightness(%d) current=%d step=%d->%d\n", value, _brightness, _brightness_step, _brightness_target);
 
-    applyBrightness(value);
     _brightness = value;
-
-    saveState();
 }
 
 void MqttManager::setColorTemp(int percent) {
     percent = constrain(percent, 0, 100);
-
-    int currentPercent = miredsToPercent(_color_temp);
-    int targetSteps = (percent * COLOR_TEMP_STEPS) / 100;
-    int currentSteps = (currentPercent * COLOR_TEMP_STEPS) / 100;
-    int diff = targetSteps - currentSteps;
-    bool direction = (diff < 0);  // true = colder, false = warmer
-
-    Serial.printf("[MQTT] setColorTemp(%d%%) current=%d%% steps=%d->%d diff=%d direction=%s\n",
-                  percent, currentPercent, currentSteps, targetSteps, diff, direction ? "colder" : "warmer");
-
-    for (int i = 0; i < abs(diff); i++) {
-        _controller->Color(direction, true);
-        delay(RF_STEP_DELAY_MS);
-    }
+    _color_target = (percent * COLOR_TEMP_STEPS) / 100;
+    Serial.printf("[MQTT] setColorTemp(%d%%) current=%d%% step=%d->%d\n", percent, miredsToPercent(_color_temp), _color_step, _color_target);
 
     _color_temp = percentToMireds(percent);
-    saveState();
+}
 
-    Serial.printf("[MQTT] Color temp set to: %d%% (%d mireds)\n", percent, _color_temp);
+// Called from loop(): one DIM and one COLOR step (or hold, see stepAxis) per RF_STEP_DELAY_MS toward
+// the targets, so a long ramp doesn't block MQTT, the web UI or serial. A new command only moves the target.
+void MqttManager::processSteps() {
+    if (!isTransitioning() || !_power_state) {
+        return;  // steps sent to an off lamp are lost, resume once it's on again
+    }
+    if (_command.hasPower && _command.power != _power_state) {
+        return;  // switching off once the command settles, steps now would be wasted
+    }
+    if (millis() - _last_step_ms < RF_STEP_DELAY_MS || !_controller->IsTxIdle()) {
+        return;
+    }
+    _last_step_ms = millis();
+
+    stepAxis(QUNTIS_CMD_DIM, _brightness_step, pacedTarget(_brightness_pace, _brightness_target), true);
+    stepAxis(QUNTIS_CMD_COLOR, _color_step, pacedTarget(_color_pace, _color_target), false);  // color UP is colder, step 0 is coldest
+    journal();
+
+    if (!isTransitioning()) {
+        Serial.printf("[MQTT] Transition done: brightness step %d, color step %d\n", _brightness_step, _color_step);
+        if (isPaced()) {
+            _brightness_pace.ms = 0;
+            _color_pace.ms = 0;
+            publishState();  // replaces the last in-between state
+        }
+    } else if (isPaced() && millis() - _last_publish_ms >= MQTT_TRANSITION_PUBLISH_MS) {
+        // Where the lamp is now, at a bounded rate instead of once per step
+        publishState((_brightness_step * 100) / BRIGHTNESS_STEPS, percentToMireds((_color_step * 100) / COLOR_TEMP_STEPS));
+    }
 }
 
-void MqttManager::applyBrightness(int target) {
-    int targetSteps = (target * BRIGHTNESS_STEPS) / 100;
-    int currentSteps = (_brightness * BRIGHTNESS_STEPS) / 100;
-    int diff = targetSteps - currentSteps;
-    bool direction = (diff > 0);  // true = brighter, false = dimmer
+void MqttManager::stepAxis(byte axis, int& step, int target, bool upIncrements) {
+    int diff = target - step;
+    if (diff == 0) {
+        return;
+    }
+    bool up = (diff > 0) == upIncrements;
+    int dir = diff > 0 ? 1 : -1;
+    float& error = axis == QUNTIS_CMD_DIM ? _brightness_hold_error : _color_hold_error;
+    bool toEnd = target == 0 || target == (axis == QUNTIS_CMD_DIM ? BRIGHTNESS_STEPS : COLOR_TEMP_STEPS);
+
+    // A hold into an end stop runs past it by the error so far and its own, the lamp clamps there and
+    // the axis is back at a known step. Any other hold adds its own error. The step only moves once
+    // the RF queue took the command, processSteps() tries again otherwise.
+    float rate = _controller->GetHoldRate();
+    if (rate > 0 && (abs(diff) >= HOLD_MIN_STEPS || (toEnd && error > 0))) {
+        float holdError = abs(diff) * HOLD_RATE_ERROR;
+        int steps = abs(diff) + (toEnd ? (int)ceilf(error + holdError) : 0);
+        if (_controller->Ramp(axis, up, (uint32_t)(steps * 1000 / rate))) {
+            step = target;
+            error = toEnd ? 0 : error + holdError;
+        }
+    } else if (axis == QUNTIS_CMD_DIM ? _controller->Dim(up, true, 0, abs(diff) > 1)
+                                      : _controller->Color(up, true, 0, abs(diff) > 1)) {
+        step += dir;
+    }
+}
 
-    Serial.printf("[MQTT] applyBrightness target=%d%% current=%d%% steps=%d->%d diff=%d direction=%s\n",
-                  target, _brightness, currentSteps, targetSteps, diff, direction ? "up" : "down");
+// Frame heard from the original remote: replay it on the tracked state. The remote wins over a
+// running transition on the axis it moved, HA gets the new state right away.
+void MqttManager::onRemoteFrame(const uint8_t* raw, uint8_t len) {
+    // Model color counts up toward colder (Color(true)), our step 0 is coldest
+    _remote.SetHoldRate(_controller->GetHoldRate());
+    _remote.Reset(_power_state, _brightness_step, COLOR_TEMP_STEPS - _color_step);
+    bool changed = _remote.Accept(raw, len);
+
+    // Our ramps stream at the cadence of the remote's last held button
+    uint32_t holdGap = _remote.GetHoldGapUs();
+    if (holdGap && holdGap != _controller->GetHoldGap()) {
+        _controller->SetHoldGap(holdGap);
+        Serial.printf("[RF] Remote holds at one frame per %luus, ramps follow it\n", (unsigned long)holdGap);
+    }
+    if (!changed) {
+        return;
+    }
 
-    for (int i = 0; i < abs(diff); i++) {
-        _controller->Dim(direction, true);
-        delay(RF_STEP_DELAY_MS);
+    _power_state = _remote.GetPower();
+    if (_remote.GetBrightness() != _brightness_step) {
+        _brightness_step = _brightness_target = _remote.GetBrightness();
+        _brightness_pace = {0, 0, _brightness_step};
+        _brightness = (_brightness_step * 100) / BRIGHTNESS_STEPS;
+    }
+    if (COLOR_TEMP_STEPS - _remote.GetColor() != _color_step) {
+        _color_step = _color_target = COLOR_TEMP_STEPS - _remote.GetColor();
+        _color_pace = {0, 0, _color_step};
+        _color_temp = percentToMireds((_color_step * 100) / COLOR_TEMP_STEPS);
     }
+    Serial.printf("[RF] Remote idx=%d: power=%s brightness step %d, color step %d\n", _remote.GetLastIndex(),
+                  _power_state ? "ON" : "OFF", _brightness_step, _color_step);
 
-    Serial.printf("[MQTT] Brightness applied: %d%%\n", target);
+    journal();
+    markDirty();
+    publishState();
 }
 
 int MqttManager::percentToMireds(int percent) {
@@ -226,18 +523,45 @@ void MqttManager::loadState() {
         Serial.println("[NVS] No saved state found, using defaults");
         return;
     }
-    _power_state = _prefs.getBool("power", false);
-    _brightness = _prefs.getInt("brightness", 50);
-    _color_temp = _prefs.getInt("color_temp", 250);
+
+    SavedState saved;
+    if (_prefs.getBytes("state", &saved, sizeof(saved)) == sizeof(saved) && saved.version == NVS_STATE_VERSION) {
+        _power_state = saved.power;
+        _brightness = saved.brightness;
+        _color_temp = saved.colorTemp;
+    } else {
+        // Written by a version that used a key per value
+        _power_state = _prefs.getBool("power", false);
+        _brightness = _prefs.getInt("brightness", 50);
+        _color_temp = _prefs.getInt("color_temp", 250);
+    }
     _prefs.end();
 
     Serial.printf("[NVS] Loaded state: power=%s brightness=%d color_temp=%d mireds\n", _power_state ? "ON" : "OFF", _brightness, _color_temp);
 }
 
+void MqttManager::markDirty() {
+    _dirty = true;
+    _dirty_ms = millis();
+}
+
+void MqttManager::flushState() {
+    if (_dirty) {
+        saveState();
+    }
+}
+
 void MqttManager::saveState() {
+    _dirty = false;
+
+    SavedState record = {NVS_STATE_VERSION, _power_state, (uint8_t)_brightness, (uint16_t)_color_temp};
+    SavedState stored;
     _prefs.begin("quntis", false);
-    _prefs.putBool("power", _power_state);
-    _prefs.putInt("brightness", _brightness);
-    _prefs.putInt("color_temp", _color_temp);
+    if (_prefs.getBytes("state", &stored, sizeof(stored)) == sizeof(stored) && memcmp(&stored, &record, sizeof(record)) == 0) {
+        _nvs_skipped++;  // back where it was, e.g. a slider dragged and released at the same spot
+    } else {
+        _prefs.putBytes("state", &record, sizeof(record));
+        _nvs_commits++;
+    }
     _prefs.end();
 }
@@ -7,6 +7,7 @@
 #include <WiFi.h>
 
 #include "QuntisControl.h"
+#include "QuntisLamp.h"
 #include "config.h"
 
 class MqttManager {
@@ -20,24 +21,55 @@ class MqttManager {
     void publishState();
     void publishAvailability(bool online);
 
-    // Getters for current state
-    bool getPowerState() { return _power_state; }
+    // Getters for current state, a power change still settling counts as applied
+    bool getPowerState() { return _command.hasPower ? _command.power : _power_state; }
     int getBrightness() { return _brightness; }
     int getColorTemp() { return _color_temp; }
     int getColorTempPercent() { return miredsToPercent(_color_temp); }
+    bool isTransitioning() { return _brightness_step != _brightness_target || _color_step != _color_target; }
 
-    // Setters (called from web UI)
-    void setPower(bool on);
+    // Setters, they only move the state, handleCommand() saves and publishes it. setPower() returns
+    // false when the RF queue had no room for the toggle, the state is unchanged then.
+    bool setPower(bool on);
     void setBrightness(int value);
     void setColorTemp(int value);
 
-    // Command handling (colorTempInMireds: true for MQTT/HA, false for WebUI)
+    int percentToMireds(int percent);  // 0-100% → 153-500 mireds
+    int miredsToPercent(int mireds);   // 153-500 mireds → 0-100%
+
+    // Command handling (colorTempInMireds: true for MQTT/HA, false for WebUI). Targets move right away,
+    // power, NVS and the state publish wait until commands stop arriving, see applyCommand().
     void handleCommand(const char* json, bool colorTempInMireds = true);
 
+    struct CoalesceStats {
+        uint32_t commands;      // handed to handleCommand()
+        uint32_t applied;       // times a merged command was applied
+        uint32_t stepsSaved;    // RF steps running each command to its target in turn would take, minus the net ones
+        uint32_t togglesSaved;  // power requests merged into a later one
+        uint32_t publishesSaved;
+        uint32_t togglesSkipped;  // power requests the lamp already matched
+    };
+    const CoalesceStats& getCoalesceStats() { return _coalesceStats; }
+    void showStats();
+
+    // Writes the state now if a change is still waiting for its debounced save
+    void flushState();
+    void resyncBrightness(int step);
+
+    // RF operations that take the lamp from what we believe it is to the desired state
+    struct Plan {
+        bool toggle;     // one OnOff
+        int dimSteps;    // + brighter, - darker
+        int colorSteps;  // + warmer, - colder
+    };
+    Plan planCommand();
+    const Plan& getLastPlan() { return _last_plan; }
+
    private:
     PubSubClient _mqtt;
     WiFiClient _wifi_client;
     QuntisControl* _controller;
+    QuntisLamp _remote;  // what frames from the original remote do to the lamp
     Preferences _prefs;
 
     // Current state
@@ -45,6 +77,47 @@ class MqttManager {
     int _brightness = 50;   // 0-100
     int _color_temp = 250;  // Mireds (153-500)
 
+    // Lamp position in RF steps, loop() steps it toward the targets set by the latest command
+    int _brightness_step = 0;
+    int _brightness_target = 0;
+    int _color_step = 0;  // 0 = coldest
+    int _color_target = 0;
+    unsigned long _last_step_ms = 0;
+    // Steps the lamp may be off from the tracked ones after held buttons, see stepAxis()
+    float _brightness_hold_error = 0;
+    float _color_hold_error = 0;
+
+    // Transition per axis: the steps from `from` to the target are spread over ms, 0 sends them as
+    // fast as RF_STEP_DELAY_MS allows. A command only restarts the axes it retargets, see handleCommand().
+    struct Pace {
+        unsigned long ms;
+        unsigned long startMs;
+        int from;
+    };
+    Pace _brightness_pace = {};
+    Pace _color_pace = {};
+    unsigned long _last_publish_ms = 0;
+
+    // Mailbox of the commands that arrived since the last applyCommand(), newer fields win
+    struct Command {
+        bool pending;
+        bool hasPower;
+        bool power;
+        unsigned long firstMs;
+        unsigned long lastMs;
+        uint16_t merged;
+        int steps;  // steps the merged commands would take one after the other
+    };
+    Command _command = {};
+    CoalesceStats _coalesceStats = {};
+    Plan _last_plan = {};
+
+    // Write-behind NVS: changes mark the state dirty, loop() saves it once it stopped changing
+    bool _dirty = false;
+    unsigned long _dirty_ms = 0;
+    uint32_t _nvs_commits = 0;
+    uint32_t _nvs_skipped = 0;  // saves that found the record unchanged
+
     // MQTT topics (built dynamically)
     String _config_topic;
     String _state_topic;
@@ -55,12 +128,19 @@ class MqttManager {
     void connect();
     void publishHomeAssistantDiscovery();
     static void messageCallback(char* topic, byte* payload, unsigned int length);
-    void applyBrightness(int target);
-    void applyColorTemp(int target);
+    void publishState(int brightness, int colorTemp);
+    void applyCommand();
+    void startTransition(Pace& pace, int step, float seconds);
+    int pacedTarget(const Pace& pace, int target);
+    bool isPaced() { return _brightness_pace.ms > 0 || _color_pace.ms > 0; }
+    void processSteps();
+    void stepAxis(byte axis, int& step, int target, bool upIncrements);
+    void onRemoteFrame(const uint8_t* raw, uint8_t len);
+    void journal();
+    void restoreJournal();
+    void markDirty();
     void saveState();
     void loadState();
-    int percentToMireds(int percent);  // 0-100% → 153-500 mireds
-    int miredsToPercent(int mireds);   // 153-500 mireds → 0-100%
 };
 
 #endif
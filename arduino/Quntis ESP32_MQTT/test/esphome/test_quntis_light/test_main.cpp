@@ -0,0 +1,490 @@
+//
+//	test_main.cpp (esphome/test_quntis_light)
+//
+//	    The ESPHome component (components/quntis_light) with a LightState in front of it, set up
+//	    like light.py does with its defaults, and a lamp model behind the simulated air. Light
+//	    calls go in like from Home Assistant, the tests check where the lamp ends up and report
+//	    the time from call to final state and the frames put on air. Scene changes and the
+//	    calibration are timed against stepping one axis after the other.
+//
+//=================================================================================================
+#include <air.h>
+#include <esphome/core/application.h>
+#include <esp_system.h>
+#include <quntis_light.h>
+#include <unity.h>
+
+#include <cmath>
+
+using namespace esphome;
+
+#define LOOP_MS 16  // App loop interval
+#define SETTLE_LIMIT_MS 60000
+#define TAIL_MS 500  // after the state machine went idle, the last burst is still on air
+#define ETA_TOLERANCE_MS LOOP_MS  // the first step goes out on the loop after the call
+
+#define BRIGHTNESS_STEPS 75  // light.py defaults
+#define COLOR_TEMP_STEPS 30
+#define STEP_DELAY_MS 50
+
+static const std::vector<uint8_t> address = {0x20, 0x21, 0x01, 0x31, 0xAA};
+static const std::vector<uint8_t> payload = {0x00, 0x76, 0x9A, 0x31};
+
+// The lamp on the desk, it hears every frame that is not lost
+static QuntisLamp* lamp;
+
+// QuntisLight with its LightState, in App's setup and loop order
+struct Desk {
+    quntis_light::QuntisLight output;
+    light::LightState state{&output};
+
+    Desk() {
+        output.set_ce_pin(1);
+        output.set_cs_pin(5);
+        output.set_spi_clk_pin(2);
+        output.set_spi_mosi_pin(4);
+        output.set_spi_miso_pin(3);
+        output.set_device_address(address);
+        output.set_device_payload(payload);
+        output.set_brightness_steps(BRIGHTNESS_STEPS);
+        output.set_color_temp_steps(COLOR_TEMP_STEPS);
+        output.set_min_mireds(153);
+        output.set_max_mireds(500);
+        output.set_step_delay(STEP_DELAY_MS);
+        output.set_repeat_gap(5000);
+        output.set_repeat_count(6);
+        output.set_frame_loss(0.5f);
+        output.set_carrier_sense(true);
+        output.set_listen_remote(true);
+        output.set_hold_rate(0);
+        state.set_gamma_correct(1.0f);
+        state.set_default_transition_length(0);
+    }
+
+    // Boots with the values ESPHome restored and a lamp that is where they say
+    void boot(bool on, float brightness, float mireds) {
+        state.current_values.set_state(on);
+        state.current_values.set_brightness(brightness);
+        state.current_values.set_color_temperature(mireds);
+        state.remote_values = state.current_values;
+
+        output.setup();
+        state.setup();
+        loop();
+        TEST_ASSERT_FALSE(output.is_failed());
+        lamp->reset(on, output.get_brightness_step(), output.get_color_step());
+        sim::Air::ClearLog();
+    }
+
+    void loop() {
+        output.loop();
+        state.loop();
+        sim::AdvanceMs(LOOP_MS);
+    }
+
+    // Runs the loop until the call is through and the lamp is where the light thinks it is
+    void settle() {
+        uint64_t limit = sim::Now() + SETTLE_LIMIT_MS * 1000ULL;
+        do {
+            loop();
+            TEST_ASSERT_LESS_THAN(limit, sim::Now());
+        } while (!output.is_idle() || state.is_transformer_active() || lamp->get_brightness() != output.get_brightness_step() ||
+                 lamp->get_color() != output.get_color_step() || lamp->get_power() != output.is_on());
+    }
+};
+
+void setUp() {
+    sim::Reset();
+    App.set_loop_interval(LOOP_MS);
+    lamp = new QuntisLamp(address.data(), payload.data(), BRIGHTNESS_STEPS, COLOR_TEMP_STEPS);
+    sim::Air::Listen([](const sim::AirFrame& frame) {
+        if (!frame.lost) {
+            lamp->accept(frame.data, frame.len);
+        }
+    });
+}
+
+void tearDown() {
+    delete lamp;
+}
+
+// Latency and frames of one operation, shown with the test results
+static void report(const char* operation, uint64_t startUs) {
+    char message[160];
+    snprintf(message, sizeof(message), "%s: %.1f ms, %u frames, %.1f ms on air", operation,
+             (sim::Now() - startUs) / 1000.0, (unsigned)sim::Air::GetLog().size(), sim::Air::GetAirtimeUs() / 1000.0);
+    TEST_MESSAGE(message);
+}
+
+//=================================================================================================
+// Light calls
+//=================================================================================================
+void test_turn_on_full() {
+    Desk desk;
+    desk.boot(false, 0.5f, 326);
+
+    uint64_t start = sim::Now();
+    desk.state.make_call().set_state(true).set_brightness(1.0f).perform();
+    desk.settle();
+    report("on, brightness 100%", start);
+
+    TEST_ASSERT_TRUE(lamp->get_power());
+    TEST_ASSERT_EQUAL(BRIGHTNESS_STEPS, lamp->get_brightness());
+}
+
+void test_scene_both_axes() {
+    Desk desk;
+    desk.boot(true, 0.8f, 200);
+
+    // Warmest is color step 0
+    uint64_t start = sim::Now();
+    desk.state.make_call().set_state(true).set_brightness(0.2f).set_color_temperature(500).perform();
+    desk.settle();
+    report("brightness 20%, 500 mireds", start);
+
+    TEST_ASSERT_EQUAL((int)(0.2f * BRIGHTNESS_STEPS), lamp->get_brightness());
+    TEST_ASSERT_EQUAL(0, lamp->get_color());
+}
+
+void test_transition_paced() {
+    Desk desk;
+    desk.boot(true, 0.0f, 326);
+
+    uint64_t start = sim::Now();
+    desk.state.make_call().set_brightness(1.0f).set_transition_length(8000).perform();
+    TEST_ASSERT_TRUE(desk.state.is_transformer_active());
+    desk.settle();
+    report("brightness 0 -> 100% over 8 s", start);
+
+    TEST_ASSERT_EQUAL(BRIGHTNESS_STEPS, lamp->get_brightness());
+    TEST_ASSERT_INT_WITHIN(500, 8000, (sim::Now() - start) / 1000);
+
+    // The write at the end of the transition is where the lamp already is, nothing more goes out
+    uint32_t commands = lamp->get_stats().commands;
+    for (int i = 0; i < TAIL_MS / LOOP_MS; i++) {
+        desk.loop();
+    }
+    TEST_ASSERT_EQUAL(commands, lamp->get_stats().commands);
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, desk.state.current_values.get_brightness());
+}
+
+// With a gamma, a call with a transition ends on the step the same call without one goes to
+void test_transition_gamma() {
+    int steps[2];
+    for (int timed = 0; timed < 2; timed++) {
+        tearDown();
+        setUp();
+        Desk desk;
+        desk.state.set_gamma_correct(2.8f);
+        desk.boot(true, 0.2f, 326);
+
+        desk.state.make_call().set_brightness(0.6f).set_transition_length(timed ? 3000 : 0).perform();
+        desk.settle();
+        steps[timed] = lamp->get_brightness();
+    }
+    TEST_ASSERT_EQUAL((int)(std::pow(0.6f, 2.8f) * BRIGHTNESS_STEPS), steps[0]);
+    TEST_ASSERT_EQUAL(steps[0], steps[1]);
+}
+
+void test_turn_off() {
+    Desk desk;
+    desk.boot(true, 0.6f, 326);
+
+    uint64_t start = sim::Now();
+    desk.state.make_call().set_state(false).perform();
+    desk.settle();
+    report("off", start);
+
+    TEST_ASSERT_FALSE(lamp->get_power());
+    TEST_ASSERT_EQUAL(1, lamp->get_stats().commands);
+}
+
+//=================================================================================================
+// Scene changes: brightness and color side by side against the planned ETA and a serial sweep
+//=================================================================================================
+// Performs the call and runs the loop until the lamp got to the given steps, returns the ms it took and
+// the ETA the light planned. The lamp moves one way per axis, the first time it is there the last step arrived.
+static uint32_t timeCall(Desk& desk, light::LightCall call, int brightness, int color, uint32_t* etaMs = nullptr) {
+    uint64_t start = sim::Now();
+    call.perform();
+    desk.loop();  // LightState writes the call, the light plans it
+    if (etaMs) {
+        *etaMs = desk.output.get_transition_eta_ms();
+    }
+    while (lamp->get_brightness() != brightness || lamp->get_color() != color) {
+        desk.loop();
+        TEST_ASSERT_LESS_THAN(start + SETTLE_LIMIT_MS * 1000ULL, sim::Now());
+    }
+    return (sim::Now() - start) / 1000;
+}
+
+void test_scene_timing() {
+    struct Scene {
+        const char* name;
+        float brightness;
+        float mireds;
+        float toBrightness;
+        float toMireds;
+    };
+    const Scene scenes[] = {
+        {"bright -> relax", 1.0f, 153, 0.4f, 500},
+        {"relax -> concentrate", 0.4f, 500, 1.0f, 200},
+        {"read -> nightlight", 0.8f, 326, 0.05f, 500},
+        {"dim a bit", 0.6f, 326, 0.5f, 326},
+    };
+
+    for (const Scene& scene : scenes) {
+        // Where the scene ends
+        int fromBrightness, fromColor, toBrightness, toColor;
+        {
+            tearDown();
+            setUp();
+            Desk desk;
+            desk.boot(true, scene.brightness, scene.mireds);
+            fromBrightness = lamp->get_brightness();
+            fromColor = lamp->get_color();
+            desk.state.make_call().set_brightness(scene.toBrightness).set_color_temperature(scene.toMireds).perform();
+            desk.settle();
+            toBrightness = lamp->get_brightness();
+            toColor = lamp->get_color();
+        }
+
+        // Before: one axis after the other, each on its own from the start of the scene
+        uint32_t serialMs = 0;
+        for (int axis = 0; axis < 2; axis++) {
+            tearDown();
+            setUp();
+            Desk desk;
+            desk.boot(true, scene.brightness, scene.mireds);
+            light::LightCall call = desk.state.make_call();
+            if (axis == 0) {
+                serialMs += timeCall(desk, call.set_brightness(scene.toBrightness), toBrightness, fromColor);
+            } else {
+                serialMs += timeCall(desk, call.set_color_temperature(scene.toMireds), fromBrightness, toColor);
+            }
+        }
+
+        tearDown();
+        setUp();
+        Desk desk;
+        desk.boot(true, scene.brightness, scene.mireds);
+        uint32_t etaMs;
+        uint32_t actualMs = timeCall(
+            desk, desk.state.make_call().set_brightness(scene.toBrightness).set_color_temperature(scene.toMireds),
+            toBrightness, toColor, &etaMs);
+        desk.settle();
+        int brightnessSteps = abs(toBrightness - fromBrightness);
+        int colorSteps = abs(toColor - fromColor);
+
+        char message[160];
+        snprintf(message, sizeof(message), "%s (%d + %d steps): %u ms, ETA %u ms, serial %u ms", scene.name,
+                 brightnessSteps, colorSteps, (unsigned)actualMs, (unsigned)etaMs, (unsigned)serialMs);
+        TEST_MESSAGE(message);
+
+        TEST_ASSERT_EQUAL((int)(scene.toBrightness * BRIGHTNESS_STEPS), toBrightness);
+        TEST_ASSERT_INT_WITHIN(ETA_TOLERANCE_MS, etaMs, actualMs);
+        if (brightnessSteps > 0 && colorSteps > 0) {
+            TEST_ASSERT_LESS_THAN(serialMs, actualMs);
+        }
+    }
+}
+
+// With the hold rate known a long move is one held button, against the same move in single steps
+void test_scene_held() {
+    uint32_t ms[2];
+    uint32_t etaMs = 0;
+    for (int held = 0; held < 2; held++) {
+        tearDown();
+        setUp();
+        Desk desk;
+        desk.output.set_hold_rate(held ? 40 : 0);
+        lamp->set_hold_rate(40);
+        desk.boot(true, 0.2f, 326);
+
+        // The lamp passes the target on the way into the end stop, it has it once the light is idle
+        int target = (int)(0.9f * BRIGHTNESS_STEPS);
+        uint64_t start = sim::Now();
+        desk.state.make_call().set_brightness(0.9f).perform();
+        desk.loop();
+        etaMs = desk.output.get_transition_eta_ms();
+        while (!desk.output.is_idle() || lamp->get_brightness() != target) {
+            desk.loop();
+            TEST_ASSERT_LESS_THAN(start + SETTLE_LIMIT_MS * 1000ULL, sim::Now());
+        }
+        ms[held] = (sim::Now() - start) / 1000;
+        desk.settle();
+        TEST_ASSERT_EQUAL(target, desk.output.get_brightness_step());
+        if (held) {
+            // Into the end stop, which is less than a hold away, and back in single steps
+            TEST_ASSERT_EQUAL(1 + BRIGHTNESS_STEPS - target, lamp->get_stats().commands);
+            TEST_ASSERT_GREATER_THAN(0, lamp->get_stats().clamped);
+        }
+    }
+
+    char message[128];
+    snprintf(message, sizeof(message), "brightness 20%% -> 90%%: held %u ms, ETA %u ms, single steps %u ms", (unsigned)ms[1],
+             (unsigned)etaMs, (unsigned)ms[0]);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_INT_WITHIN(ETA_TOLERANCE_MS, etaMs, ms[1]);
+    TEST_ASSERT_LESS_THAN(ms[0], ms[1]);
+}
+
+//=================================================================================================
+// Calibration: both axes at once into their nearest end stop, against the serial full sweep
+//=================================================================================================
+// Both axes swept all the way, one after the other
+static uint32_t serialSweepMs() {
+    uint32_t ms = 0;
+    for (int axis = 0; axis < 2; axis++) {
+        tearDown();
+        setUp();
+        Desk desk;
+        desk.boot(true, 0.0f, 153);
+        light::LightCall call = desk.state.make_call();
+        if (axis == 0) {
+            ms += timeCall(desk, call.set_brightness(1.0f), BRIGHTNESS_STEPS, lamp->get_color());
+        } else {
+            ms += timeCall(desk, call.set_color_temperature(500), lamp->get_brightness(), 0);
+        }
+    }
+    tearDown();
+    setUp();
+    return ms;
+}
+
+static void calibrate(float holdRate) {
+    uint32_t serialMs = serialSweepMs();
+    Desk desk;
+    desk.output.set_hold_rate(holdRate);
+    lamp->set_hold_rate(holdRate);
+    desk.boot(true, 0.6f, 250);
+    lamp->reset(true, 10, 5);  // not where the light thinks, as after a power cut
+
+    uint64_t start = sim::Now();
+    desk.output.calibrate(true);
+    TEST_ASSERT_TRUE(desk.output.is_calibrating());
+    while (desk.output.is_calibrating()) {
+        desk.loop();
+        TEST_ASSERT_LESS_THAN(start + SETTLE_LIMIT_MS * 1000ULL, sim::Now());
+    }
+    desk.settle();
+
+    char message[128];
+    snprintf(message, sizeof(message), "full calibration, %s: %u ms, serial sweep %u ms, %u frames",
+             holdRate > 0 ? "held" : "single steps", (unsigned)desk.output.get_last_calibration_ms(), (unsigned)serialMs,
+             (unsigned)sim::Air::GetLog().size());
+    TEST_MESSAGE(message);
+
+    // Nearest to where the light thought it was: 45 of 75 steps, 250 mireds is on the cold half
+    TEST_ASSERT_EQUAL(BRIGHTNESS_STEPS, lamp->get_brightness());
+    TEST_ASSERT_EQUAL(COLOR_TEMP_STEPS, lamp->get_color());
+    TEST_ASSERT_EQUAL(lamp->get_brightness(), desk.output.get_brightness_step());
+    TEST_ASSERT_EQUAL(lamp->get_color(), desk.output.get_color_step());
+    TEST_ASSERT_LESS_THAN(serialMs, desk.output.get_last_calibration_ms());
+}
+
+void test_calibrate_steps() {
+    calibrate(0);
+}
+
+void test_calibrate_held() {
+    calibrate(40);
+}
+
+//=================================================================================================
+// Reset with RTC memory kept: the journal brings the steps back
+//=================================================================================================
+// The last step before the reset may not have made it on air, even with the ramp done: a move near
+// the end stop it stepped toward goes through the end stop
+void test_journal_last_step() {
+    // Its timer stays on the clock, like in the other tests it is gone with the next sim::Reset()
+    Desk before;
+    before.boot(true, 0.4f, 326);
+    before.state.make_call().set_brightness(10.5f / BRIGHTNESS_STEPS).perform();
+    before.settle();
+    sim::AdvanceMs(1000);  // the last repeats go out before the reset
+    sim::SetResetReason(ESP_RST_SW);
+
+    // ESPHome restores the values of the last call, the journal has the step the lamp is at
+    Desk desk;
+    desk.boot(true, 10.5f / BRIGHTNESS_STEPS, 326);
+    desk.settle();  // the restored state is published first
+    TEST_ASSERT_EQUAL(10, desk.output.get_brightness_step());
+
+    desk.state.make_call().set_brightness(2.5f / BRIGHTNESS_STEPS).perform();
+    desk.settle();
+    TEST_ASSERT_EQUAL(2, lamp->get_brightness());
+    TEST_ASSERT_GREATER_THAN(0, lamp->get_stats().clamped);  // re-anchored at 0 on the way
+}
+
+//=================================================================================================
+// The original remote: QuntisLight follows the lamp and publishes it
+//=================================================================================================
+void test_follows_remote() {
+    Desk desk;
+    desk.boot(true, 0.6f, 326);
+    int brightness = desk.output.get_brightness_step();
+    uint32_t publishes = desk.state.get_publish_count();
+
+    // One more transmitter with the same address and its own index
+    QuntisControl remote;
+    remote.set_device_address(address);
+    remote.set_device_payload(payload);
+    TEST_ASSERT_TRUE(remote.begin());
+    remote.set_index(0x80);
+    for (int i = 0; i < 5; i++) {
+        remote.Dim(true);
+    }
+    uint64_t limit = sim::Now() + SETTLE_LIMIT_MS * 1000ULL;
+    while (!remote.is_tx_idle() && sim::Now() < limit) {
+        desk.loop();
+    }
+    for (int i = 0; i < TAIL_MS / LOOP_MS; i++) {
+        desk.loop();
+    }
+
+    TEST_ASSERT_EQUAL(brightness + 5, lamp->get_brightness());
+    TEST_ASSERT_EQUAL(lamp->get_brightness(), desk.output.get_brightness_step());
+    TEST_ASSERT_GREATER_THAN(publishes, desk.state.get_publish_count());
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, (float)(brightness + 5) / BRIGHTNESS_STEPS, desk.state.remote_values.get_brightness());
+}
+
+// A held button on the remote sets the cadence of our own ramps
+void test_learns_hold_gap() {
+    Desk desk;
+    desk.boot(true, 0.6f, 326);
+
+    QuntisControl remote;
+    remote.set_device_address(address);
+    remote.set_device_payload(payload);
+    TEST_ASSERT_TRUE(remote.begin());
+    remote.set_index(0x80);
+    remote.set_hold_gap(8000);
+    remote.ramp(QUNTIS_CMD_DIM, false, 500);
+    remote.Dim(true);
+    uint64_t limit = sim::Now() + SETTLE_LIMIT_MS * 1000ULL;
+    while (!remote.is_tx_idle() && sim::Now() < limit) {
+        desk.loop();
+    }
+    desk.loop();
+
+    // Frames are timed when the loop polls them, over 60 of them that's within a few percent
+    TEST_ASSERT_INT_WITHIN(250, 8000, (int)desk.output.get_hold_gap());
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_turn_on_full);
+    RUN_TEST(test_scene_both_axes);
+    RUN_TEST(test_transition_paced);
+    RUN_TEST(test_transition_gamma);
+    RUN_TEST(test_turn_off);
+    RUN_TEST(test_scene_timing);
+    RUN_TEST(test_scene_held);
+    RUN_TEST(test_calibrate_steps);
+    RUN_TEST(test_calibrate_held);
+    RUN_TEST(test_journal_last_step);
+    RUN_TEST(test_follows_remote);
+    RUN_TEST(test_learns_hold_gap);
+    return UNITY_END();
+}
@@ -0,0 +1,49 @@
+//
+//	test_main.cpp (esphome/test_xn297)
+//
+//	    The component's copy of the XN297 codec against the reference encoder, like test_xn297
+//	    does for the firmware's
+//
+//=================================================================================================
+#include <unity.h>
+#include <xn297.h>
+#include <xn297_reference.h>
+
+static const uint8_t address[5] = {0x20, 0x21, 0x01, 0x31, 0xAA};
+
+void setUp() {
+    sim::Reset();
+}
+
+void tearDown() {
+}
+
+void test_lut_matches_bitwise() {
+    XN297 codec;
+    XN297_Frame frame;
+    uint8_t msg[20];
+    uint8_t expected[32];
+
+    for (uint8_t addrLen = 3; addrLen <= 5; addrLen++) {
+        codec.XN297_SetTXAddr(address, addrLen);
+        for (uint8_t len = 1; len <= sizeof(msg); len++) {
+            for (int value = 0; value < 256; value++) {
+                for (uint8_t i = 0; i < len; i++) {
+                    msg[i] = value + i * 37;
+                }
+                codec.XN297_PrepareFrame(frame, msg, len, len);
+                uint8_t frameLen = codec.XN297_FinishFrame(frame, msg);
+
+                uint8_t expectedLen = xn297_reference::Encode(address, addrLen, msg, len, expected);
+                TEST_ASSERT_EQUAL(expectedLen, frameLen);
+                TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, frame.buf, expectedLen);
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_lut_matches_bitwise);
+    return UNITY_END();
+}
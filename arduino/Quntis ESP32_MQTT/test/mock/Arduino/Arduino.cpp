@@ -0,0 +1,218 @@
+//
+//	Arduino.cpp (native)
+//
+//	    Simulated clock, event queue and Serial behind the Arduino.h shim
+//
+//=================================================================================================
+#include <Arduino.h>
+#include <SPI.h>
+
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+
+HardwareSerial Serial;
+SPIClass SPI;
+
+namespace sim {
+
+namespace {
+
+uint64_t now = SIM_START_US;
+uint32_t sequence = 0;
+EventId lastId = 0;
+bool inEvent = false;
+uint64_t blockedUs = 0;
+bool verbose = false;
+std::mt19937 rng(1);
+
+// Ordered by time, events at the same time in the order they were added
+typedef std::pair<uint64_t, uint32_t> EventKey;
+std::map<EventKey, std::pair<EventId, std::function<void()>>> events;
+std::map<EventId, EventKey> eventKeys;
+
+std::vector<std::function<void()>>& resetHooks() {
+    static std::vector<std::function<void()>> hooks;
+    return hooks;
+}
+
+// Runs the first event if it is due by limit
+bool RunNext(uint64_t limit) {
+    if (events.empty() || events.begin()->first.first > limit) {
+        return false;
+    }
+    auto it = events.begin();
+    uint64_t at = it->first.first;
+    std::function<void()> event = std::move(it->second.second);
+    eventKeys.erase(it->second.first);
+    events.erase(it);
+
+    if (at > now) {
+        now = at;
+    }
+    inEvent = true;
+    event();
+    inEvent = false;
+    return true;
+}
+
+}  // namespace
+
+void Reset(uint32_t seed) {
+    now = SIM_START_US;
+    events.clear();
+    eventKeys.clear();
+    inEvent = false;
+    blockedUs = 0;
+    rng.seed(seed);
+    for (auto& hook : resetHooks()) {
+        hook();
+    }
+}
+
+void OnReset(std::function<void()> reset) {
+    resetHooks().push_back(reset);
+}
+
+uint64_t Now() {
+    return now;
+}
+
+void Advance(uint64_t us) {
+    if (inEvent) {
+        now += us;
+        blockedUs += us;
+        return;
+    }
+    uint64_t end = now + us;
+    while (RunNext(end)) {
+    }
+    if (end > now) {
+        now = end;
+    }
+}
+
+void AdvanceMs(uint32_t ms) {
+    Advance((uint64_t)ms * 1000);
+}
+
+bool RunUntil(std::function<bool()> done, uint64_t limitUs) {
+    uint64_t end = now + limitUs;
+    while (!done()) {
+        if (!RunNext(end)) {
+            now = end > now ? end : now;
+            return done();
+        }
+    }
+    return true;
+}
+
+EventId At(uint64_t us, std::function<void()> event) {
+    EventKey key(us, sequence++);
+    EventId id = ++lastId;
+    events[key] = std::make_pair(id, event);
+    eventKeys[id] = key;
+    return id;
+}
+
+void Cancel(EventId id) {
+    auto it = eventKeys.find(id);
+    if (it != eventKeys.end()) {
+        events.erase(it->second);
+        eventKeys.erase(it);
+    }
+}
+
+bool InEvent() {
+    return inEvent;
+}
+
+uint64_t GetBlockedUs() {
+    return blockedUs;
+}
+
+void SetVerbose(bool enabled) {
+    verbose = enabled;
+}
+
+bool IsVerbose() {
+    return verbose;
+}
+
+uint32_t Random() {
+    return rng();
+}
+
+}  // namespace sim
+
+//=================================================================================================
+//	Time
+//=================================================================================================
+unsigned long millis() {
+    return sim::Now() / 1000;
+}
+
+unsigned long micros() {
+    return sim::Now();
+}
+
+void delay(unsigned long ms) {
+    sim::Advance((uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(unsigned int us) {
+    sim::Advance(us);
+}
+
+void yield() {
+}
+
+long random(long max) {
+    return max > 0 ? sim::Random() % max : 0;
+}
+
+long random(long min, long max) {
+    return max > min ? min + random(max - min) : min;
+}
+
+//=================================================================================================
+//	Serial
+//=================================================================================================
+size_t HardwareSerial::printf(const char* format, ...) {
+    char buf[512];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    print(buf);
+    return len < 0 ? 0 : len;
+}
+
+size_t HardwareSerial::print(const char* s) {
+    if (sim::IsVerbose()) {
+        fputs(s, stdout);
+    }
+    return strlen(s);
+}
+
+size_t HardwareSerial::print(char c) {
+    char s[2] = {c, 0};
+    return print(s);
+}
+
+size_t HardwareSerial::print(int value, int base) {
+    return print((long)value, base);
+}
+
+size_t HardwareSerial::print(long value, int base) {
+    char buf[24];
+    snprintf(buf, sizeof(buf), base == HEX ? "%lX" : "%ld", value);
+    return print(buf);
+}
+
+size_t HardwareSerial::print(double value, int digits) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.*f", digits, value);
+    return print(buf);
+}
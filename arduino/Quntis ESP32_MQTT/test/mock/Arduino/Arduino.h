@@ -0,0 +1,122 @@
+//
+//	Arduino.h (native)
+//
+//	    Just enough of the Arduino core to build the firmware on the host. Time comes from
+//	    the simulated clock in sim.h, delay() lets it run instead of sleeping.
+//
+//=================================================================================================
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#include "sim.h"
+
+typedef uint8_t byte;
+
+#define DEC 10
+#define HEX 16
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+long random(long max);
+long random(long min, long max);
+
+// FreeRTOS critical sections, everything runs in one thread on the host
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+
+//=================================================================================================
+//	String
+//=================================================================================================
+class String {
+   public:
+    String() {}
+    String(const char* s) : _str(s ? s : "") {}
+    String(const std::string& s) : _str(s) {}
+    String(int value) : _str(std::to_string(value)) {}
+
+    const char* c_str() const { return _str.c_str(); }
+    unsigned int length() const { return _str.size(); }
+    unsigned char concat(const char* s) {
+        _str += s;
+        return 1;
+    }
+
+    String& operator=(const char* s) {
+        _str = s ? s : "";
+        return *this;
+    }
+    String& operator+=(const String& s) {
+        _str += s._str;
+        return *this;
+    }
+    bool operator==(const char* s) const { return _str == s; }
+    char operator[](unsigned int index) const { return index < _str.size() ? _str[index] : 0; }
+
+   private:
+    std::string _str;
+};
+
+// What operator+ returns in the Arduino core, ArduinoJson adapts it like a String
+class StringSumHelper : public String {
+   public:
+    StringSumHelper(const String& s) : String(s) {}
+};
+
+inline StringSumHelper operator+(const String& a, const String& b) {
+    String sum(a);
+    sum += b;
+    return sum;
+}
+inline StringSumHelper operator+(const String& a, const char* b) { return a + String(b); }
+
+//=================================================================================================
+//	Serial
+//
+//	    Output goes to stdout only with sim::SetVerbose(true), tests stay readable otherwise
+//=================================================================================================
+class HardwareSerial {
+   public:
+    void begin(unsigned long baud) {}
+    int available() { return 0; }
+    int read() { return -1; }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3)));
+    size_t print(const char* s);
+    size_t print(const String& s) { return print(s.c_str()); }
+    size_t print(char c);
+    size_t print(int value, int base = DEC);
+    size_t print(unsigned int value, int base = DEC) { return print((long)value, base); }
+    size_t print(long value, int base = DEC);
+    size_t print(unsigned long value, int base = DEC) { return print((long)value, base); }
+    size_t print(double value, int digits = 2);
+    size_t println() { return print("\n"); }
+    template <typename T>
+    size_t println(const T& value) {
+        return print(value) + println();
+    }
+    template <typename T>
+    size_t println(const T& value, int format) {
+        return print(value, format) + println();
+    }
+};
+
+extern HardwareSerial Serial;
+
+#endif
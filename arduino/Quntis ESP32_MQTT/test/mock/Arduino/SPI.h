@@ -0,0 +1,20 @@
+//
+//	SPI.h (native)
+//
+//	    The mock RF24 radios talk to sim::Air, not over SPI, so there is nothing to set up
+//
+//=================================================================================================
+#ifndef SPI_H
+#define SPI_H
+
+#include <Arduino.h>
+
+class SPIClass {
+   public:
+    void begin(int8_t sck = -1, int8_t miso = -1, int8_t mosi = -1, int8_t ss = -1) {}
+    void end() {}
+};
+
+extern SPIClass SPI;
+
+#endif
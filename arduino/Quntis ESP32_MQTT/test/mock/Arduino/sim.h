@@ -0,0 +1,54 @@
+//
+//	sim.h
+//
+//	    Simulated clock for the native tests. Everything that happens at a given time (timer
+//	    callbacks, frames finishing on air) is an event, Advance() runs them in time order.
+//
+//=================================================================================================
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+
+#include <functional>
+
+namespace sim {
+
+// Boot time the clock starts at, not 0 so "never" sentinels in the firmware stay apart from it
+#define SIM_START_US 1000000ULL
+
+// Back to SIM_START_US with no events pending and the random generator reseeded
+void Reset(uint32_t seed = 1);
+
+// Other mocks clear their state (radios, NVS, shutdown handlers) along with Reset()
+void OnReset(std::function<void()> reset);
+
+uint64_t Now();
+
+// Runs the events due in the next us microseconds, then leaves the clock at the end of it.
+// Called from inside an event (busy waits in a timer callback) it only moves the clock.
+void Advance(uint64_t us);
+void AdvanceMs(uint32_t ms);
+
+// Runs events until done() is true, at most limitUs. Returns false when it ran into the limit.
+bool RunUntil(std::function<bool()> done, uint64_t limitUs);
+
+typedef uint32_t EventId;
+EventId At(uint64_t us, std::function<void()> event);
+void Cancel(EventId id);
+bool InEvent();
+
+// Time busy waits (delay, delayMicroseconds) spent inside events since Reset(). A timer callback
+// that waits holds up every other esp_timer.
+uint64_t GetBlockedUs();
+
+// Generator behind random(), reseeded by Reset()
+uint32_t Random();
+
+// Serial output to stdout
+void SetVerbose(bool verbose);
+bool IsVerbose();
+
+}  // namespace sim
+
+#endif
@@ -0,0 +1,7 @@
+//
+//	config.h (native)
+//
+//	    src/config.h is not in git, the tests build against the defaults in the template
+//
+//=================================================================================================
+#include "../../../src/config.h.template"
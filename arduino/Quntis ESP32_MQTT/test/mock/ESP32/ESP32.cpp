@@ -0,0 +1,203 @@
+//
+//	ESP32.cpp (native)
+//
+//	    esp_timer, esp_system and Preferences on top of the simulated clock
+//
+//=================================================================================================
+#include <Arduino.h>
+#include <Preferences.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+//=================================================================================================
+//	esp_timer
+//=================================================================================================
+struct esp_timer {
+    esp_timer_create_args_t args;
+    bool armed;
+    sim::EventId event;
+};
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* create_args, esp_timer_handle_t* out_handle) {
+    if (!create_args || !create_args->callback || !out_handle) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    *out_handle = new esp_timer{*create_args, false, 0};
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    if (!timer) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (timer->armed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->armed = true;
+    timer->event = sim::At(sim::Now() + timeout_us, [timer]() {
+        timer->armed = false;
+        timer->args.callback(timer->args.arg);
+    });
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    if (!timer || !timer->armed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    sim::Cancel(timer->event);
+    timer->armed = false;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    if (!timer) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (timer->armed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    delete timer;
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer) {
+    return timer && timer->armed;
+}
+
+int64_t esp_timer_get_time() {
+    return sim::Now();
+}
+
+//=================================================================================================
+//	esp_system
+//=================================================================================================
+static esp_reset_reason_t resetReason = ESP_RST_POWERON;
+
+static std::vector<shutdown_handler_t>& shutdownHandlers() {
+    static std::vector<shutdown_handler_t> handlers;
+    return handlers;
+}
+
+esp_reset_reason_t esp_reset_reason() {
+    return resetReason;
+}
+
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handle) {
+    shutdownHandlers().push_back(handle);
+    return ESP_OK;
+}
+
+esp_err_t esp_unregister_shutdown_handler(shutdown_handler_t handle) {
+    auto& handlers = shutdownHandlers();
+    auto it = std::find(handlers.begin(), handlers.end(), handle);
+    if (it == handlers.end()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    handlers.erase(it);
+    return ESP_OK;
+}
+
+namespace sim {
+
+void SetResetReason(esp_reset_reason_t reason) {
+    resetReason = reason;
+}
+
+void Shutdown() {
+    for (shutdown_handler_t handler : shutdownHandlers()) {
+        handler();
+    }
+}
+
+}  // namespace sim
+
+//=================================================================================================
+//	Preferences
+//=================================================================================================
+typedef std::map<std::string, std::vector<uint8_t>> NvsNamespace;
+
+static std::map<std::string, NvsNamespace>& nvs() {
+    static std::map<std::string, NvsNamespace> partition;
+    return partition;
+}
+
+static uint32_t nvsWrites = 0;
+
+static struct EspReset {
+    EspReset() {
+        sim::OnReset([]() {
+            resetReason = ESP_RST_POWERON;
+            shutdownHandlers().clear();
+            nvs().clear();
+            nvsWrites = 0;
+        });
+    }
+} espReset;
+
+bool Preferences::begin(const char* name, bool readOnly, const char* partition_label) {
+    if (readOnly && !nvs().count(name)) {
+        return false;  // like NVS, a read-only open does not create the namespace
+    }
+    _name = name;
+    _readOnly = readOnly;
+    _started = true;
+    nvs()[_name];
+    return true;
+}
+
+void Preferences::end() {
+    _started = false;
+}
+
+bool Preferences::clear() {
+    if (!_started || _readOnly) {
+        return false;
+    }
+    nvs()[_name].clear();
+    nvsWrites++;
+    return true;
+}
+
+bool Preferences::remove(const char* key) {
+    if (!_started || _readOnly) {
+        return false;
+    }
+    nvsWrites++;
+    return nvs()[_name].erase(key) > 0;
+}
+
+bool Preferences::isKey(const char* key) {
+    return _started && nvs()[_name].count(key);
+}
+
+size_t Preferences::putBytes(const char* key, const void* value, size_t len) {
+    if (!_started || _readOnly) {
+        return 0;
+    }
+    const uint8_t* bytes = static_cast<const uint8_t*>(value);
+    nvs()[_name][key].assign(bytes, bytes + len);
+    nvsWrites++;
+    return len;
+}
+
+size_t Preferences::getBytes(const char* key, void* buf, size_t maxLen) {
+    if (!_started) {
+        return 0;
+    }
+    NvsNamespace& ns = nvs()[_name];
+    auto it = ns.find(key);
+    if (it == ns.end() || it->second.size() > maxLen) {
+        return 0;
+    }
+    memcpy(buf, it->second.data(), it->second.size());
+    return it->second.size();
+}
+
+uint32_t Preferences::GetWriteCount() {
+    return nvsWrites;
+}
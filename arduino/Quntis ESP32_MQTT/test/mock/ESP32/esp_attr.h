@@ -0,0 +1,15 @@
+//
+//	esp_attr.h (native)
+//
+//	    No RTC memory on the host, RTC_NOINIT_ATTR data is plain static memory that keeps its
+//	    content for the whole test run, like it does over a software reset
+//
+//=================================================================================================
+#ifndef ESP_ATTR_H
+#define ESP_ATTR_H
+
+#define RTC_NOINIT_ATTR
+#define RTC_DATA_ATTR
+#define IRAM_ATTR
+
+#endif
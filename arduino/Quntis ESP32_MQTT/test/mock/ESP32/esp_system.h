@@ -0,0 +1,42 @@
+//
+//	esp_system.h (native)
+//
+//	    Reset reason and shutdown handlers, set and run by the tests through sim::
+//
+//=================================================================================================
+#ifndef ESP_SYSTEM_H
+#define ESP_SYSTEM_H
+
+#include "esp_err.h"
+
+typedef enum {
+    ESP_RST_UNKNOWN,
+    ESP_RST_POWERON,
+    ESP_RST_EXT,
+    ESP_RST_SW,
+    ESP_RST_PANIC,
+    ESP_RST_INT_WDT,
+    ESP_RST_TASK_WDT,
+    ESP_RST_WDT,
+    ESP_RST_DEEPSLEEP,
+    ESP_RST_BROWNOUT,
+    ESP_RST_SDIO,
+} esp_reset_reason_t;
+
+typedef void (*shutdown_handler_t)(void);
+
+esp_reset_reason_t esp_reset_reason();
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handle);
+esp_err_t esp_unregister_shutdown_handler(shutdown_handler_t handle);
+
+namespace sim {
+
+// What esp_reset_reason() reports, ESP_RST_POWERON after sim::Reset()
+void SetResetReason(esp_reset_reason_t reason);
+
+// Runs the shutdown handlers like esp_restart() does before it resets
+void Shutdown();
+
+}  // namespace sim
+
+#endif
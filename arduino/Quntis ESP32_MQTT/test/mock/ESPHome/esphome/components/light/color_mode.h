@@ -0,0 +1,26 @@
+//
+//	color_mode.h (native)
+//
+//=================================================================================================
+#ifndef ESPHOME_LIGHT_COLOR_MODE_H
+#define ESPHOME_LIGHT_COLOR_MODE_H
+
+#include <stdint.h>
+
+namespace esphome {
+namespace light {
+
+enum class ColorMode : uint8_t {
+    UNKNOWN,
+    ON_OFF,
+    BRIGHTNESS,
+    WHITE,
+    COLOR_TEMPERATURE,
+    COLD_WARM_WHITE,
+    RGB,
+};
+
+}  // namespace light
+}  // namespace esphome
+
+#endif
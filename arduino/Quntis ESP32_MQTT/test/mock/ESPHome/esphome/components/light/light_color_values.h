@@ -0,0 +1,57 @@
+//
+//	light_color_values.h (native)
+//
+//	    State, brightness and color temperature of a light, the channels QuntisLight has
+//
+//=================================================================================================
+#ifndef ESPHOME_LIGHT_COLOR_VALUES_H
+#define ESPHOME_LIGHT_COLOR_VALUES_H
+
+#include "color_mode.h"
+#include "esphome/core/helpers.h"
+
+namespace esphome {
+namespace light {
+
+class LightColorValues {
+   public:
+    ColorMode get_color_mode() const { return color_mode_; }
+    void set_color_mode(ColorMode color_mode) { color_mode_ = color_mode; }
+
+    bool is_on() const { return state_ != 0.0f; }
+    float get_state() const { return state_; }
+    void set_state(float state) { state_ = clamp_(state, 0.0f, 1.0f); }
+    void set_state(bool state) { state_ = state ? 1.0f : 0.0f; }
+
+    float get_brightness() const { return brightness_; }
+    void set_brightness(float brightness) { brightness_ = clamp_(brightness, 0.0f, 1.0f); }
+
+    float get_color_temperature() const { return color_temperature_; }
+    void set_color_temperature(float color_temperature) { color_temperature_ = color_temperature; }
+
+    // Output brightness: off is 0, gamma corrected like the LightState does for its outputs
+    void as_brightness(float* brightness, float gamma = 0) const {
+        *brightness = gamma_correct(state_ * brightness_, gamma);
+    }
+
+    static LightColorValues lerp(const LightColorValues& start, const LightColorValues& end, float completion) {
+        LightColorValues v = end;
+        v.state_ = start.state_ + (end.state_ - start.state_) * completion;
+        v.brightness_ = start.brightness_ + (end.brightness_ - start.brightness_) * completion;
+        v.color_temperature_ = start.color_temperature_ + (end.color_temperature_ - start.color_temperature_) * completion;
+        return v;
+    }
+
+   protected:
+    static float clamp_(float value, float low, float high) { return value < low ? low : (value > high ? high : value); }
+
+    ColorMode color_mode_{ColorMode::COLOR_TEMPERATURE};
+    float state_{0.0f};
+    float brightness_{1.0f};
+    float color_temperature_{0.0f};
+};
+
+}  // namespace light
+}  // namespace esphome
+
+#endif
@@ -0,0 +1,34 @@
+//
+//	light_output.h (native)
+//
+//=================================================================================================
+#ifndef ESPHOME_LIGHT_OUTPUT_H
+#define ESPHOME_LIGHT_OUTPUT_H
+
+#include <memory>
+
+#include "light_state.h"
+#include "light_traits.h"
+#include "light_transformer.h"
+
+namespace esphome {
+namespace light {
+
+class LightOutput {
+   public:
+    virtual ~LightOutput() {}
+
+    virtual LightTraits get_traits() = 0;
+    virtual void setup_state(LightState* state) {}
+    // Every change of the current values, transitions included
+    virtual void update_state(LightState* state) {}
+    virtual void write_state(LightState* state) = 0;
+    virtual std::unique_ptr<LightTransformer> create_default_transition() {
+        return std::unique_ptr<LightTransformer>(new LightTransitionTransformer());
+    }
+};
+
+}  // namespace light
+}  // namespace esphome
+
+#endif
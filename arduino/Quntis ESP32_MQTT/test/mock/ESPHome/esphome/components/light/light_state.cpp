@@ -0,0 +1,74 @@
+//
+//	light_state.cpp (native)
+//
+//=================================================================================================
+#include "light_state.h"
+
+#include "light_output.h"
+
+namespace esphome {
+namespace light {
+
+void LightCall::perform() {
+    LightColorValues target = parent_->remote_values;
+    if (state_.has_value()) {
+        target.set_state(*state_);
+    }
+    if (brightness_.has_value()) {
+        target.set_brightness(*brightness_);
+    }
+    if (color_temperature_.has_value()) {
+        target.set_color_temperature(*color_temperature_);
+    }
+
+    uint32_t length = transition_length_.value_or(parent_->default_transition_length_);
+    if (length != 0) {
+        parent_->start_transition_(target, length);
+    } else {
+        parent_->set_immediately_(target);
+    }
+    parent_->remote_values = target;
+    parent_->publishes_++;
+}
+
+void LightState::setup() {
+    output_->setup_state(this);
+}
+
+void LightState::loop() {
+    if (transformer_ != nullptr) {
+        auto values = transformer_->apply();
+        if (values.has_value()) {
+            current_values = *values;
+            output_->update_state(this);
+            next_write_ = true;
+        }
+        if (transformer_->is_finished()) {
+            current_values = transformer_->get_target_values();
+            transformer_->stop();
+            transformer_ = nullptr;
+            next_write_ = true;
+        }
+    }
+
+    if (next_write_) {
+        next_write_ = false;
+        output_->write_state(this);
+    }
+}
+
+void LightState::start_transition_(const LightColorValues& target, uint32_t length) {
+    transformer_ = output_->create_default_transition();
+    transformer_->setup(current_values, target, length);
+    transformer_->start();
+}
+
+void LightState::set_immediately_(const LightColorValues& target) {
+    transformer_ = nullptr;
+    current_values = target;
+    output_->update_state(this);
+    next_write_ = true;
+}
+
+}  // namespace light
+}  // namespace esphome
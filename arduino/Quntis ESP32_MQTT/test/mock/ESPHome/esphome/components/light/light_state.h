@@ -0,0 +1,97 @@
+//
+//	light_state.h (native)
+//
+//	    The LightState of an ESPHome light: calls set the remote (HA) values and start a
+//	    transition or write them at once, loop() runs the transition and writes to the output.
+//	    The test owns it and calls loop() the way App does.
+//
+//=================================================================================================
+#ifndef ESPHOME_LIGHT_STATE_H
+#define ESPHOME_LIGHT_STATE_H
+
+#include <memory>
+
+#include "esphome/core/component.h"
+#include "esphome/core/optional.h"
+#include "light_color_values.h"
+#include "light_transformer.h"
+
+namespace esphome {
+namespace light {
+
+class LightOutput;
+class LightState;
+
+class LightCall {
+   public:
+    explicit LightCall(LightState* parent) : parent_(parent) {}
+
+    LightCall& set_state(bool state) {
+        state_ = state;
+        return *this;
+    }
+    LightCall& set_brightness(float brightness) {
+        brightness_ = brightness;
+        return *this;
+    }
+    LightCall& set_color_temperature(float color_temperature) {
+        color_temperature_ = color_temperature;
+        return *this;
+    }
+    LightCall& set_transition_length(uint32_t transition_length) {
+        transition_length_ = transition_length;
+        return *this;
+    }
+
+    void perform();
+
+   protected:
+    LightState* parent_;
+    optional<bool> state_;
+    optional<float> brightness_;
+    optional<float> color_temperature_;
+    optional<uint32_t> transition_length_;
+};
+
+class LightState : public Component {
+   public:
+    explicit LightState(LightOutput* output) : output_(output) {}
+
+    void setup() override;
+    void loop() override;
+
+    LightCall make_call() { return LightCall(this); }
+
+    // What the output shows right now, and what was last asked for
+    LightColorValues current_values;
+    LightColorValues remote_values;
+
+    float get_gamma_correct() const { return gamma_correct_; }
+    void set_gamma_correct(float gamma_correct) { gamma_correct_ = gamma_correct; }
+    void set_default_transition_length(uint32_t length) { default_transition_length_ = length; }
+
+    bool is_transformer_active() { return transformer_ != nullptr; }
+    void current_values_as_brightness(float* brightness) { current_values.as_brightness(brightness, gamma_correct_); }
+
+    // Calls performed, what HA sees as state updates
+    uint32_t get_publish_count() const { return publishes_; }
+
+   protected:
+    friend LightCall;
+
+    void start_transition_(const LightColorValues& target, uint32_t length);
+    void set_immediately_(const LightColorValues& target);
+
+    LightOutput* output_;
+    std::unique_ptr<LightTransformer> transformer_;
+    float gamma_correct_{2.8f};
+    uint32_t default_transition_length_{1000};
+    // Like ESPHome, the first loop() writes the restored state to the output
+    bool next_write_{true};
+    uint32_t publishes_{0};
+};
+
+}  // namespace light
+}  // namespace esphome
+
+#endif
@@ -0,0 +1,35 @@
+//
+//	light_traits.h (native)
+//
+//=================================================================================================
+#ifndef ESPHOME_LIGHT_TRAITS_H
+#define ESPHOME_LIGHT_TRAITS_H
+
+#include <set>
+
+#include "color_mode.h"
+
+namespace esphome {
+namespace light {
+
+class LightTraits {
+   public:
+    const std::set<ColorMode>& get_supported_color_modes() const { return supported_color_modes_; }
+    void set_supported_color_modes(std::set<ColorMode> modes) { supported_color_modes_ = modes; }
+    bool supports_color_mode(ColorMode mode) const { return supported_color_modes_.count(mode) > 0; }
+
+    float get_min_mireds() const { return min_mireds_; }
+    void set_min_mireds(float min_mireds) { min_mireds_ = min_mireds; }
+    float get_max_mireds() const { return max_mireds_; }
+    void set_max_mireds(float max_mireds) { max_mireds_ = max_mireds; }
+
+   protected:
+    std::set<ColorMode> supported_color_modes_;
+    float min_mireds_{0};
+    float max_mireds_{0};
+};
+
+}  // namespace light
+}  // namespace esphome
+
+#endif
@@ -0,0 +1,60 @@
+//
+//	light_transformer.h (native)
+//
+//	    A transition from the current to the target values, LightState::loop() polls it
+//
+//=================================================================================================
+#ifndef ESPHOME_LIGHT_TRANSFORMER_H
+#define ESPHOME_LIGHT_TRANSFORMER_H
+
+#include "esphome/core/hal.h"
+#include "esphome/core/optional.h"
+#include "light_color_values.h"
+
+namespace esphome {
+namespace light {
+
+class LightTransformer {
+   public:
+    virtual ~LightTransformer() = default;
+
+    void setup(const LightColorValues& start_values, const LightColorValues& target_values, uint32_t length) {
+        start_time_ = millis();
+        length_ = length;
+        start_values_ = start_values;
+        target_values_ = target_values;
+    }
+
+    virtual void start() {}
+    // The values to write, nothing when they did not change
+    virtual optional<LightColorValues> apply() = 0;
+    virtual void stop() {}
+    virtual bool is_finished() { return get_progress_() >= 1.0f; }
+
+    const LightColorValues& get_start_values() const { return start_values_; }
+    const LightColorValues& get_target_values() const { return target_values_; }
+
+   protected:
+    float get_progress_() {
+        uint32_t elapsed = millis() - start_time_;
+        return length_ == 0 || elapsed >= length_ ? 1.0f : (float)elapsed / length_;
+    }
+
+    uint32_t start_time_{0};
+    uint32_t length_{0};
+    LightColorValues start_values_;
+    LightColorValues target_values_;
+};
+
+// ESPHome's default: values interpolated over the length
+class LightTransitionTransformer : public LightTransformer {
+   public:
+    optional<LightColorValues> apply() override {
+        return LightColorValues::lerp(start_values_, target_values_, get_progress_());
+    }
+};
+
+}  // namespace light
+}  // namespace esphome
+
+#endif
@@ -0,0 +1,11 @@
+//
+//	application.cpp (native)
+//
+//=================================================================================================
+#include "application.h"
+
+namespace esphome {
+
+Application App;
+
+}  // namespace esphome
@@ -0,0 +1,28 @@
+//
+//	application.h (native)
+//
+//	    ESPHome's App as far as QuntisLight uses it: the loop interval. The test runs the loop
+//	    itself and sets the interval it advances the clock by.
+//
+//=================================================================================================
+#ifndef ESPHOME_CORE_APPLICATION_H
+#define ESPHOME_CORE_APPLICATION_H
+
+#include <stdint.h>
+
+namespace esphome {
+
+class Application {
+   public:
+    void set_loop_interval(uint32_t loop_interval) { loop_interval_ = loop_interval; }
+    uint32_t get_loop_interval() const { return loop_interval_; }
+
+   protected:
+    uint32_t loop_interval_{16};
+};
+
+extern Application App;
+
+}  // namespace esphome
+
+#endif
@@ -0,0 +1,35 @@
+//
+//	component.h (native)
+//
+//	    ESPHome's Component as far as QuntisLight uses it. The test calls setup() and loop()
+//	    itself, there is no App running the components.
+//
+//=================================================================================================
+#ifndef ESPHOME_CORE_COMPONENT_H
+#define ESPHOME_CORE_COMPONENT_H
+
+namespace esphome {
+
+namespace setup_priority {
+const float HARDWARE = 800.0f;
+}  // namespace setup_priority
+
+class Component {
+   public:
+    virtual ~Component() {}
+
+    virtual void setup() {}
+    virtual void loop() {}
+    virtual void dump_config() {}
+    virtual float get_setup_priority() const { return 0.0f; }
+
+    void mark_failed() { failed_ = true; }
+    bool is_failed() const { return failed_; }
+
+   protected:
+    bool failed_{false};
+};
+
+}  // namespace esphome
+
+#endif
@@ -0,0 +1,21 @@
+//
+//	hal.h (native)
+//
+//	    ESPHome's time functions are the Arduino ones on the simulated clock
+//
+//=================================================================================================
+#ifndef ESPHOME_CORE_HAL_H
+#define ESPHOME_CORE_HAL_H
+
+#include <Arduino.h>
+
+namespace esphome {
+
+using ::delay;
+using ::delayMicroseconds;
+using ::micros;
+using ::millis;
+
+}  // namespace esphome
+
+#endif
@@ -0,0 +1,29 @@
+//
+//	helpers.h (native)
+//
+//=================================================================================================
+#ifndef ESPHOME_CORE_HELPERS_H
+#define ESPHOME_CORE_HELPERS_H
+
+#include <math.h>
+#include <sim.h>
+#include <stdint.h>
+
+namespace esphome {
+
+// From the generator behind random(), reseeded by sim::Reset()
+inline uint32_t random_uint32() { return sim::Random(); }
+
+inline float gamma_correct(float value, float gamma) {
+    if (value <= 0.0f) {
+        return 0.0f;
+    }
+    if (gamma <= 0.0f) {
+        return value;
+    }
+    return powf(value, gamma);
+}
+
+}  // namespace esphome
+
+#endif
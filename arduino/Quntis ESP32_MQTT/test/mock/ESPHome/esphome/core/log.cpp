@@ -0,0 +1,25 @@
+//
+//	log.cpp (native)
+//
+//=================================================================================================
+#include "log.h"
+
+#include <sim.h>
+#include <stdarg.h>
+#include <stdio.h>
+
+namespace esphome {
+
+void esp_log_printf_(char level, const char* tag, const char* format, ...) {
+    if (!sim::IsVerbose()) {
+        return;
+    }
+    printf("[%c][%s]: ", level, tag);
+    va_list args;
+    va_start(args, format);
+    vprintf(format, args);
+    va_end(args);
+    printf("\n");
+}
+
+}  // namespace esphome
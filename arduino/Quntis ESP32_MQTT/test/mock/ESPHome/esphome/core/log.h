@@ -0,0 +1,27 @@
+//
+//	log.h (native)
+//
+//	    ESP_LOGx print to stdout with sim::SetVerbose(true), like Serial
+//
+//=================================================================================================
+#ifndef ESPHOME_CORE_LOG_H
+#define ESPHOME_CORE_LOG_H
+
+#define ESP_LOGE(tag, ...) esphome::esp_log_printf_('E', tag, __VA_ARGS__)
+#define ESP_LOGW(tag, ...) esphome::esp_log_printf_('W', tag, __VA_ARGS__)
+#define ESP_LOGI(tag, ...) esphome::esp_log_printf_('I', tag, __VA_ARGS__)
+#define ESP_LOGD(tag, ...) esphome::esp_log_printf_('D', tag, __VA_ARGS__)
+#define ESP_LOGV(tag, ...) esphome::esp_log_printf_('V', tag, __VA_ARGS__)
+#define ESP_LOGVV(tag, ...) esphome::esp_log_printf_('V', tag, __VA_ARGS__)
+#define ESP_LOGCONFIG(tag, ...) esphome::esp_log_printf_('C', tag, __VA_ARGS__)
+
+#define ONOFF(b) ((b) ? "ON" : "OFF")
+#define YESNO(b) ((b) ? "YES" : "NO")
+
+namespace esphome {
+
+void esp_log_printf_(char level, const char* tag, const char* format, ...) __attribute__((format(printf, 3, 4)));
+
+}  // namespace esphome
+
+#endif
@@ -0,0 +1,17 @@
+//
+//	optional.h (native)
+//
+//=================================================================================================
+#ifndef ESPHOME_CORE_OPTIONAL_H
+#define ESPHOME_CORE_OPTIONAL_H
+
+#include <optional>
+
+namespace esphome {
+
+template <typename T>
+using optional = std::optional<T>;
+
+}  // namespace esphome
+
+#endif
@@ -0,0 +1,120 @@
+//
+//	PubSubClient.cpp (native)
+//
+//=================================================================================================
+#include <PubSubClient.h>
+
+#include <algorithm>
+
+namespace {
+
+struct Broker {
+    std::vector<PubSubClient::Message> published;
+    std::vector<PubSubClient*> clients;
+    bool down = false;
+};
+
+Broker& broker() {
+    static Broker state;
+    return state;
+}
+
+struct BrokerReset {
+    BrokerReset() {
+        sim::OnReset([]() {
+            broker().published.clear();
+            broker().down = false;
+        });
+    }
+} brokerReset;
+
+}  // namespace
+
+PubSubClient::~PubSubClient() {
+    auto& clients = broker().clients;
+    clients.erase(std::remove(clients.begin(), clients.end(), this), clients.end());
+}
+
+PubSubClient& PubSubClient::setCallback(MQTT_CALLBACK_SIGNATURE) {
+    _callback = callback;
+    return *this;
+}
+
+bool PubSubClient::setBufferSize(uint16_t size) {
+    _bufferSize = size;
+    return size > 0;
+}
+
+bool PubSubClient::connect(const char* id, const char* willTopic, uint8_t willQos, bool willRetain,
+                           const char* willMessage) {
+    if (broker().down) {
+        return false;
+    }
+    _connected = true;
+    auto& clients = broker().clients;
+    if (std::find(clients.begin(), clients.end(), this) == clients.end()) {
+        clients.push_back(this);
+    }
+    return true;
+}
+
+bool PubSubClient::connect(const char* id, const char* user, const char* pass, const char* willTopic, uint8_t willQos,
+                           bool willRetain, const char* willMessage) {
+    return connect(id, willTopic, willQos, willRetain, willMessage);
+}
+
+bool PubSubClient::publish(const char* topic, const char* payload, bool retained) {
+    // Like the real client: header, topic and payload have to fit the buffer
+    if (!_connected || 5 + 2 + strlen(topic) + strlen(payload) > _bufferSize) {
+        return false;
+    }
+    broker().published.push_back({topic, payload, retained, millis()});
+    return true;
+}
+
+bool PubSubClient::subscribe(const char* topic) {
+    if (!_connected) {
+        return false;
+    }
+    _topics.push_back(topic);
+    return true;
+}
+
+const std::vector<PubSubClient::Message>& PubSubClient::GetPublished() {
+    return broker().published;
+}
+
+void PubSubClient::ClearPublished() {
+    broker().published.clear();
+}
+
+std::string PubSubClient::GetLast(const char* topic) {
+    auto& published = broker().published;
+    for (auto it = published.rbegin(); it != published.rend(); ++it) {
+        if (it->topic == topic) {
+            return it->payload;
+        }
+    }
+    return "";
+}
+
+bool PubSubClient::Receive(const char* topic, const char* payload) {
+    bool delivered = false;
+    std::vector<PubSubClient*> clients = broker().clients;
+    for (PubSubClient* client : clients) {
+        if (!client->_connected || !client->_callback ||
+            std::find(client->_topics.begin(), client->_topics.end(), topic) == client->_topics.end()) {
+            continue;
+        }
+        // The callback may write its terminator behind the payload, like into the client's buffer
+        std::vector<char> buf(payload, payload + strlen(payload) + 1);
+        std::vector<char> name(topic, topic + strlen(topic) + 1);
+        client->_callback(name.data(), (uint8_t*)buf.data(), strlen(payload));
+        delivered = true;
+    }
+    return delivered;
+}
+
+void PubSubClient::SetBrokerDown(bool down) {
+    broker().down = down;
+}
@@ -0,0 +1,68 @@
+//
+//	PubSubClient.h (native)
+//
+//	    Broker in memory: publishes are recorded and Receive() hands a message to the callback of
+//	    the client subscribed to its topic, like the broker would from loop()
+//
+//=================================================================================================
+#ifndef PUBSUBCLIENT_H
+#define PUBSUBCLIENT_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#define MQTT_CONNECTED 0
+#define MQTT_DISCONNECTED -1
+
+#define MQTT_CALLBACK_SIGNATURE std::function<void(char*, uint8_t*, unsigned int)> callback
+
+class PubSubClient {
+   public:
+    struct Message {
+        std::string topic;
+        std::string payload;
+        bool retained;
+        unsigned long ms;
+    };
+
+    PubSubClient(Client& client) {}
+    ~PubSubClient();
+
+    PubSubClient& setServer(const char* domain, uint16_t port) { return *this; }
+    PubSubClient& setCallback(MQTT_CALLBACK_SIGNATURE);
+    bool setBufferSize(uint16_t size);
+
+    bool connect(const char* id, const char* willTopic, uint8_t willQos, bool willRetain, const char* willMessage);
+    bool connect(const char* id, const char* user, const char* pass, const char* willTopic, uint8_t willQos,
+                 bool willRetain, const char* willMessage);
+    void disconnect() { _connected = false; }
+    bool connected() { return _connected; }
+    int state() { return _connected ? MQTT_CONNECTED : MQTT_DISCONNECTED; }
+    bool loop() { return _connected; }
+
+    bool publish(const char* topic, const char* payload) { return publish(topic, payload, false); }
+    bool publish(const char* topic, const char* payload, bool retained);
+    bool subscribe(const char* topic);
+
+    // Everything published since sim::Reset(), by any client
+    static const std::vector<Message>& GetPublished();
+    static void ClearPublished();
+    // Last payload published to topic, empty when there was none
+    static std::string GetLast(const char* topic);
+    // Delivers a message to the clients subscribed to topic, false when there are none
+    static bool Receive(const char* topic, const char* payload);
+    // connect() fails while this is set
+    static void SetBrokerDown(bool down);
+
+   private:
+    bool _connected = false;
+    uint16_t _bufferSize = 256;
+    std::function<void(char*, uint8_t*, unsigned int)> _callback;
+    std::vector<std::string> _topics;
+};
+
+#endif
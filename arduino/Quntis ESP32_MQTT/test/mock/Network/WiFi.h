@@ -0,0 +1,19 @@
+//
+//	WiFi.h (native)
+//
+//	    Only the client PubSubClient is built on, there is no network stack behind it
+//
+//=================================================================================================
+#ifndef WIFI_H
+#define WIFI_H
+
+#include <Arduino.h>
+
+class Client {
+   public:
+    virtual ~Client() {}
+};
+
+class WiFiClient : public Client {};
+
+#endif
@@ -0,0 +1,373 @@
+//
+//	RF24.cpp (native)
+//
+//=================================================================================================
+#include <RF24.h>
+
+#include <algorithm>
+#include <map>
+
+// Interference is sampled this often over a frame
+#define AIR_SAMPLE_US 10
+
+namespace {
+
+std::vector<RF24*>& radios() {
+    static std::vector<RF24*> all;
+    return all;
+}
+
+struct AirState {
+    std::map<int, sim::Air::Listener> listeners;
+    int lastListener = 0;
+    float loss = 0;
+    std::function<bool(uint64_t us)> interference;
+    std::vector<sim::AirFrame> log;
+    std::map<uint32_t, sim::AirFrame> external;  // Transmit() frames still on air
+    uint32_t lastExternal = 0;
+};
+
+AirState& air() {
+    static AirState state;
+    return state;
+}
+
+struct AirReset {
+    AirReset() {
+        sim::OnReset([]() { air() = AirState(); });
+    }
+} airReset;
+
+uint64_t FrameUs(uint8_t addressWidth, uint8_t len) {
+    return (uint64_t)(1 + addressWidth + len) * AIR_US_PER_BYTE;
+}
+
+}  // namespace
+
+//=================================================================================================
+//	sim::Air
+//=================================================================================================
+namespace sim {
+
+int Air::Listen(Listener listener) {
+    AirState& state = air();
+    state.listeners[++state.lastListener] = listener;
+    return state.lastListener;
+}
+
+void Air::Unlisten(int id) {
+    air().listeners.erase(id);
+}
+
+void Air::SetLoss(float loss) {
+    air().loss = loss;
+}
+
+void Air::SetInterference(std::function<bool(uint64_t us)> busy) {
+    air().interference = busy;
+}
+
+bool Air::IsBusy(uint64_t fromUs, uint64_t toUs, const void* except) {
+    AirState& state = air();
+    if (state.interference) {
+        for (uint64_t us = fromUs; us < toUs; us += AIR_SAMPLE_US) {
+            if (state.interference(us)) {
+                return true;
+            }
+        }
+        if (state.interference(toUs)) {
+            return true;
+        }
+    }
+
+    auto overlaps = [&](const AirFrame& f) { return f.sender != except && f.startUs < toUs && f.endUs > fromUs; };
+    for (auto it = state.log.rbegin(); it != state.log.rend() && it->endUs + 1000 >= fromUs; ++it) {
+        if (overlaps(*it)) {
+            return true;
+        }
+    }
+    for (auto& entry : state.external) {
+        if (overlaps(entry.second)) {
+            return true;
+        }
+    }
+    for (RF24* radio : radios()) {
+        if (radio != except && !radio->_tx.empty() && radio->_tx.front().onAir &&
+            radio->_tx.front().startUs < toUs && radio->_tx.front().endUs > fromUs) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Air::Transmit(uint8_t channel, const uint8_t* address, uint8_t addressWidth, const uint8_t* data, uint8_t len) {
+    AirFrame frame = {};
+    frame.startUs = sim::Now();
+    frame.endUs = frame.startUs + FrameUs(addressWidth, len);
+    frame.channel = channel;
+    frame.addressWidth = addressWidth;
+    memcpy(frame.address, address, addressWidth);
+    frame.len = len > sizeof(frame.data) ? sizeof(frame.data) : len;
+    memcpy(frame.data, data, frame.len);
+
+    AirState& state = air();
+    uint32_t id = ++state.lastExternal;
+    state.external[id] = frame;
+    sim::At(frame.endUs, [id]() {
+        auto it = air().external.find(id);
+        if (it == air().external.end()) {
+            return;
+        }
+        AirFrame done = it->second;
+        air().external.erase(it);
+        Air::Deliver(done);
+    });
+}
+
+const std::vector<AirFrame>& Air::GetLog() {
+    return air().log;
+}
+
+void Air::ClearLog() {
+    air().log.clear();
+}
+
+uint64_t Air::GetAirtimeUs() {
+    uint64_t us = 0;
+    for (const AirFrame& frame : air().log) {
+        us += frame.endUs - frame.startUs;
+    }
+    return us;
+}
+
+void Air::Deliver(AirFrame& frame) {
+    AirState& state = air();
+    if (state.loss > 0 && sim::Random() % 1000000 < state.loss * 1000000) {
+        frame.lost = true;
+    }
+    if (!frame.lost && IsBusy(frame.startUs, frame.endUs, frame.sender)) {
+        frame.lost = true;
+    }
+    state.log.push_back(frame);
+
+    std::map<int, Listener> listeners = state.listeners;  // a listener may unlisten
+    for (auto& entry : listeners) {
+        entry.second(frame);
+    }
+    if (frame.lost) {
+        return;
+    }
+    for (RF24* radio : radios()) {
+        if (radio != frame.sender) {
+            radio->receive(frame);
+        }
+    }
+}
+
+}  // namespace sim
+
+//=================================================================================================
+//	RF24
+//=================================================================================================
+RF24::RF24(uint32_t spi_speed) : _self(std::make_shared<RF24*>(this)) {
+    radios().push_back(this);
+}
+
+RF24::RF24(rf24_gpio_pin_t cepin, rf24_gpio_pin_t cspin, uint32_t spi_speed) : RF24(spi_speed) {
+}
+
+RF24::~RF24() {
+    auto& all = radios();
+    all.erase(std::remove(all.begin(), all.end(), this), all.end());
+}
+
+bool RF24::begin() {
+    _ce = false;
+    _listening = false;
+    _tx.clear();
+    _rx.clear();
+    return true;
+}
+
+bool RF24::begin(rf24_gpio_pin_t cepin, rf24_gpio_pin_t cspin) {
+    return begin();
+}
+
+void RF24::openWritingPipe(const uint8_t* address) {
+    memcpy(_txAddress, address, _addressWidth);
+}
+
+void RF24::openReadingPipe(uint8_t number, const uint8_t* address) {
+    if (number == 0) {
+        memcpy(_rxAddress, address, _addressWidth);
+    }
+}
+
+void RF24::write_register(uint8_t reg, const uint8_t* buf, uint8_t len) {
+    if (reg == TX_ADDR) {
+        memcpy(_txAddress, buf, len > 5 ? 5 : len);
+    } else if (reg == RX_ADDR_P0) {
+        memcpy(_rxAddress, buf, len > 5 ? 5 : len);
+    }
+}
+
+void RF24::write_register(uint8_t reg, uint8_t value, bool is_cmd_only) {
+    if (is_cmd_only) {
+        return;
+    }
+    switch (reg) {
+        case SETUP_AW:
+            _addressWidth = constrain(value + 2, 3, 5);
+            break;
+        case RF_CH:
+            _channel = value;
+            break;
+        case RX_PW_P0:
+            setPayloadSize(value);
+            break;
+    }
+}
+
+//=================================================================================================
+//	RX
+//=================================================================================================
+void RF24::startListening() {
+    update();
+    _listening = true;
+    _ce = true;
+    _listenUs = sim::Now();
+}
+
+void RF24::stopListening() {
+    update();
+    _listening = false;
+    _ce = false;
+    delayMicroseconds(RF24_TX_DELAY_US);
+}
+
+bool RF24::available() {
+    update();
+    return !_rx.empty();
+}
+
+void RF24::read(void* buf, uint8_t len) {
+    update();
+    memset(buf, 0, len);
+    if (_rx.empty()) {
+        return;
+    }
+    memcpy(buf, _rx.front().data(), std::min<size_t>(len, _rx.front().size()));
+    _rx.pop_front();
+}
+
+void RF24::flush_rx() {
+    _rx.clear();
+}
+
+bool RF24::testRPD() {
+    update();
+    uint64_t from = _listenUs + AIR_SETTLE_US;
+    return _listening && sim::Now() > from && sim::Air::IsBusy(from, sim::Now(), this);
+}
+
+void RF24::receive(const sim::AirFrame& frame) {
+    if (!_listening || frame.channel != _channel || frame.addressWidth != _addressWidth ||
+        _listenUs + AIR_SETTLE_US > frame.startUs || memcmp(frame.address, _rxAddress, _addressWidth) != 0 ||
+        _rx.size() >= 3) {
+        return;
+    }
+    std::vector<uint8_t> data(_payloadSize, 0);
+    memcpy(data.data(), frame.data, std::min(_payloadSize, frame.len));
+    _rx.push_back(data);
+}
+
+//=================================================================================================
+//	TX
+//=================================================================================================
+bool RF24::write(const void* buf, uint8_t len) {
+    startFastWrite(buf, len, false, true);
+    return txStandBy();
+}
+
+void RF24::startFastWrite(const void* buf, uint8_t len, const bool multicast, bool startTx) {
+    update();
+    if (_tx.size() >= 3) {
+        return;  // the chip drops writes to a full FIFO
+    }
+
+    // Static payloads: short writes are padded to the payload size
+    TxFrame frame = {};
+    memcpy(frame.data, buf, std::min(len, _payloadSize));
+    frame.len = _payloadSize;
+    _tx.push_back(frame);
+
+    if (startTx) {
+        _ce = true;
+    }
+    startNext(std::max(sim::Now(), _idleUs));
+}
+
+bool RF24::txStandBy() {
+    update();
+    while (!_tx.empty() && !_listening) {
+        _ce = true;
+        startNext(std::max(sim::Now(), _idleUs));
+        uint64_t end = _tx.front().endUs;
+        if (end > sim::Now()) {
+            delayMicroseconds(end - sim::Now());
+        }
+        update();
+    }
+    _ce = false;
+    return true;
+}
+
+void RF24::flush_tx() {
+    while (_tx.size() > (!_tx.empty() && _tx.front().onAir ? 1 : 0)) {
+        _tx.pop_back();
+    }
+}
+
+bool RF24::isFifo(bool about_tx, bool check_empty) {
+    update();
+    size_t size = about_tx ? _tx.size() : _rx.size();
+    return check_empty ? size == 0 : size >= 3;
+}
+
+void RF24::update() {
+    while (!_tx.empty() && _tx.front().onAir && _tx.front().endUs <= sim::Now()) {
+        TxFrame done = _tx.front();
+        _tx.pop_front();
+        _idleUs = done.endUs;
+
+        sim::AirFrame frame = {};
+        frame.startUs = done.startUs;
+        frame.endUs = done.endUs;
+        frame.channel = _channel;
+        frame.addressWidth = _addressWidth;
+        memcpy(frame.address, _txAddress, _addressWidth);
+        memcpy(frame.data, done.data, done.len);
+        frame.len = done.len;
+        frame.sender = this;
+        sim::Air::Deliver(frame);
+
+        startNext(done.endUs);
+    }
+}
+
+void RF24::startNext(uint64_t earliest) {
+    if (_tx.empty() || _tx.front().onAir || !_ce || _listening) {
+        return;
+    }
+    TxFrame& frame = _tx.front();
+    frame.startUs = earliest + AIR_SETTLE_US;
+    frame.endUs = frame.startUs + FrameUs(_addressWidth, frame.len);
+    frame.onAir = true;
+
+    std::weak_ptr<RF24*> self = _self;
+    sim::At(frame.endUs, [self]() {
+        if (auto radio = self.lock()) {
+            (*radio)->update();
+        }
+    });
+}
@@ -0,0 +1,127 @@
+//
+//	RF24.h (native)
+//
+//	    The part of the RF24 library the firmware uses, on top of sim::Air. The TX FIFO is
+//	    3 deep and a frame takes AIR_SETTLE_US plus its bytes at 1 Mbps, blocking calls
+//	    (write, txStandBy) let the simulated clock run until they would return.
+//
+//=================================================================================================
+#ifndef RF24_H
+#define RF24_H
+
+#include <Arduino.h>
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "air.h"
+#include "nRF24L01.h"
+
+// txDelay of the RF24 library at 1 Mbps, stopListening() waits it out
+#define RF24_TX_DELAY_US 280
+
+typedef uint16_t rf24_gpio_pin_t;
+
+typedef enum {
+    RF24_PA_MIN = 0,
+    RF24_PA_LOW,
+    RF24_PA_HIGH,
+    RF24_PA_MAX,
+    RF24_PA_ERROR
+} rf24_pa_dbm_e;
+
+typedef enum {
+    RF24_1MBPS = 0,
+    RF24_2MBPS,
+    RF24_250KBPS
+} rf24_datarate_e;
+
+typedef enum {
+    RF24_CRC_DISABLED = 0,
+    RF24_CRC_8,
+    RF24_CRC_16
+} rf24_crclength_e;
+
+class RF24 {
+   public:
+    RF24(uint32_t spi_speed = 10000000);
+    RF24(rf24_gpio_pin_t cepin, rf24_gpio_pin_t cspin, uint32_t spi_speed = 10000000);
+    ~RF24();
+
+    bool begin();
+    bool begin(rf24_gpio_pin_t cepin, rf24_gpio_pin_t cspin);
+    bool isChipConnected() { return true; }
+
+    void setPALevel(uint8_t level, bool lnaEnable = true) {}
+    void setChannel(uint8_t channel) { _channel = channel; }
+    uint8_t getChannel() { return _channel; }
+    void setPayloadSize(uint8_t size) { _payloadSize = size > 32 ? 32 : size; }
+    uint8_t getPayloadSize() { return _payloadSize; }
+    void enableDynamicPayloads() {}
+    void disableDynamicPayloads() {}
+    void disableAckPayload() {}
+    bool setDataRate(rf24_datarate_e speed) { return speed == RF24_1MBPS; }
+    void setAutoAck(bool enable) {}
+    void setAddressWidth(uint8_t a_width) { _addressWidth = constrain(a_width, 3, 5); }
+    void setCRCLength(rf24_crclength_e length) {}
+    void disableCRC() {}
+    void setRetries(uint8_t delay, uint8_t count) {}
+    void printDetails() {}
+    void printPrettyDetails() {}
+    void powerUp() {}
+    void powerDown() {}
+
+    void openWritingPipe(const uint8_t* address);
+    void openReadingPipe(uint8_t number, const uint8_t* address);
+
+    void startListening();
+    void stopListening();
+    bool available();
+    void read(void* buf, uint8_t len);
+    void flush_rx();
+    bool testRPD();
+
+    bool write(const void* buf, uint8_t len);
+    void startFastWrite(const void* buf, uint8_t len, const bool multicast, bool startTx = true);
+    bool txStandBy();
+    void flush_tx();
+    bool isFifo(bool about_tx, bool check_empty);
+
+   protected:
+    void write_register(uint8_t reg, const uint8_t* buf, uint8_t len);
+    void write_register(uint8_t reg, uint8_t value, bool is_cmd_only = false);
+
+   private:
+    struct TxFrame {
+        uint8_t data[32];
+        uint8_t len;
+        uint64_t startUs;
+        uint64_t endUs;
+        bool onAir;
+    };
+
+    // Finishes the frames whose time is up and puts the next one on air, every call that looks
+    // at the FIFOs runs it first
+    void update();
+    void startNext(uint64_t earliest);
+    void receive(const sim::AirFrame& frame);
+    friend class sim::Air;
+
+    // Events hold a weak reference, a radio that is gone by the end of its frame is skipped
+    std::shared_ptr<RF24*> _self;
+
+    uint8_t _channel = 76;
+    uint8_t _payloadSize = 32;
+    uint8_t _addressWidth = 5;
+    uint8_t _txAddress[5] = {0};
+    uint8_t _rxAddress[5] = {0};
+    bool _ce = false;
+    bool _listening = false;
+    uint64_t _listenUs = 0;
+    uint64_t _idleUs = 0;  // end of the last frame
+    std::deque<TxFrame> _tx;
+    std::deque<std::vector<uint8_t>> _rx;
+};
+
+#endif
@@ -0,0 +1,63 @@
+//
+//	air.h (native)
+//
+//	    The 2.4 GHz band as the mock RF24 radios see it: every frame one of them sends is logged
+//	    with its time on air and handed to the listeners and to the radios in RX on the same
+//	    channel and address. Loss and interference decide which frames get through.
+//
+//=================================================================================================
+#ifndef SIM_AIR_H
+#define SIM_AIR_H
+
+#include <stdint.h>
+
+#include <functional>
+#include <vector>
+
+namespace sim {
+
+// 1 Mbps, 8us per byte, and the PLL settles 130us before each frame
+#define AIR_US_PER_BYTE 8
+#define AIR_SETTLE_US 130
+
+struct AirFrame {
+    uint64_t startUs;
+    uint64_t endUs;
+    uint8_t channel;
+    uint8_t address[5];  // RF address (for XN297 frames the preamble bytes)
+    uint8_t addressWidth;
+    uint8_t data[32];    // payload as written to the TX FIFO
+    uint8_t len;
+    const void* sender;  // radio it came from, nullptr for Transmit()
+    bool lost;           // dropped by SetLoss() or interference, listeners see it anyway
+};
+
+class Air {
+   public:
+    typedef std::function<void(const AirFrame& frame)> Listener;
+
+    // Called at the end of every frame, lost ones included. Returns an id for Unlisten().
+    static int Listen(Listener listener);
+    static void Unlisten(int id);
+
+    // Chance that a frame does not reach the receivers
+    static void SetLoss(float loss);
+    // Busy channel (a WiFi burst): frames overlapping a busy time are lost and RPD is set
+    static void SetInterference(std::function<bool(uint64_t us)> busy);
+    static bool IsBusy(uint64_t fromUs, uint64_t toUs, const void* except = nullptr);
+
+    // Frame from a transmitter that is not a mock RF24 (the original remote), starts now
+    static void Transmit(uint8_t channel, const uint8_t* address, uint8_t addressWidth, const uint8_t* data, uint8_t len);
+
+    static const std::vector<AirFrame>& GetLog();
+    static void ClearLog();
+    // Time the log's frames were on air, settle times not counted
+    static uint64_t GetAirtimeUs();
+
+    // Used by the radios
+    static void Deliver(AirFrame& frame);
+};
+
+}  // namespace sim
+
+#endif
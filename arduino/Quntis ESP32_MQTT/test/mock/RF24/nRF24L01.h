@@ -0,0 +1,26 @@
+//
+//	nRF24L01.h (native)
+//
+//	    Register map, the subset the mock RF24 and XN297 use
+//
+//=================================================================================================
+#ifndef NRF24L01_H
+#define NRF24L01_H
+
+#define NRF_CONFIG 0x00
+#define EN_AA 0x01
+#define EN_RXADDR 0x02
+#define SETUP_AW 0x03
+#define SETUP_RETR 0x04
+#define RF_CH 0x05
+#define RF_SETUP 0x06
+#define NRF_STATUS 0x07
+#define RPD 0x09
+#define RX_ADDR_P0 0x0A
+#define TX_ADDR 0x10
+#define RX_PW_P0 0x11
+#define FIFO_STATUS 0x17
+#define DYNPD 0x1C
+#define FEATURE 0x1D
+
+#endif
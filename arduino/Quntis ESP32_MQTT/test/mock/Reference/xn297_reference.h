@@ -0,0 +1,80 @@
+//
+//	xn297_reference.h (native)
+//
+//	    The XN297 encoder the way XN297_WritePayload did it before the lookup tables and the
+//	    prepared frames: CRC bit by bit, bit reversal in a loop, everything encoded per frame.
+//	    The tests hold both codecs to it byte for byte, the benchmark times it as the baseline.
+//
+//=================================================================================================
+#ifndef XN297_REFERENCE_H
+#define XN297_REFERENCE_H
+
+#include <stdint.h>
+
+namespace xn297_reference {
+
+static const uint8_t scramble[] = {
+    0xe3, 0xb1, 0x4b, 0xea, 0x85, 0xbc, 0xe5, 0x66,
+    0x0d, 0xae, 0x8c, 0x88, 0x12, 0x69, 0xee, 0x1f,
+    0xc7, 0x62, 0x97, 0xd5, 0x0b, 0x79, 0xca, 0xcc,
+    0x1b, 0x5d, 0x19, 0x10, 0x24, 0xd3, 0xdc, 0x3f,
+    0x8e, 0xc5, 0x2f};
+
+static const uint16_t crc_xorout[] = {
+    0x0000, 0x3448, 0x9BA7, 0x8BBB, 0x85E1, 0x3E8C,
+    0x451E, 0x18E6, 0x6B24, 0xE7AB, 0x3828, 0x814B,
+    0xD461, 0xF494, 0x2503, 0x691D, 0xFE8B, 0x9BA7,
+    0x8B17, 0x2920, 0x8B5F, 0x61B1, 0xD391, 0x7401,
+    0x2138, 0x129F, 0xB3A0, 0x2988};
+
+static const uint16_t polynomial = 0x1021;
+static const uint16_t initial = 0xb5d2;
+
+inline uint8_t BitReverse(uint8_t b_in) {
+    uint8_t b_out = 0;
+    for (uint8_t i = 0; i < 8; ++i) {
+        b_out = (b_out << 1) | (b_in & 1);
+        b_in >>= 1;
+    }
+    return b_out;
+}
+
+inline uint16_t Crc16Update(uint16_t crc, unsigned char a) {
+    crc ^= a << 8;
+    for (uint8_t i = 0; i < 8; ++i) {
+        if (crc & 0x8000) {
+            crc = (crc << 1) ^ polynomial;
+        } else {
+            crc = crc << 1;
+        }
+    }
+    return crc;
+}
+
+// The bytes XN297_WritePayload hands to the radio for msg to addr, CRC included. Returns
+// their count, addresses shorter than 4 bytes start with the 0x55 preamble byte.
+inline uint8_t Encode(const uint8_t* addr, uint8_t addr_len, const uint8_t* msg, uint8_t len, uint8_t* buf) {
+    uint8_t last = 0;
+    if (addr_len < 4) {
+        buf[last++] = 0x55;
+    }
+    for (uint8_t i = 0; i < addr_len; ++i) {
+        buf[last++] = addr[addr_len - i - 1] ^ scramble[i];
+    }
+    for (uint8_t i = 0; i < len; ++i) {
+        buf[last++] = BitReverse(msg[i]) ^ scramble[addr_len + i];
+    }
+    uint8_t offset = addr_len < 4 ? 1 : 0;
+    uint16_t crc = initial;
+    for (uint8_t i = offset; i < last; ++i) {
+        crc = Crc16Update(crc, buf[i]);
+    }
+    crc ^= crc_xorout[addr_len - 3 + len];
+    buf[last++] = crc >> 8;
+    buf[last++] = crc & 0xff;
+    return last;
+}
+
+}  // namespace xn297_reference
+
+#endif
@@ -0,0 +1,235 @@
+//
+//	test_main.cpp (test_benchmark)
+//
+//	    Host micro-benchmarks of the hot paths: frame encoding (also with the bit by bit reference
+//	    encoder) and decoding, the JSON command, the percent conversions and the cost of the TX
+//	    scheduler and MqttManager::loop(). Every run writes bench_results.json (or
+//	    $QUNTIS_BENCH_FILE), one flat object of ns per operation, so two builds can be diffed
+//	    before they go on the lamps.
+//
+//=================================================================================================
+#include <ArduinoJson.h>
+#include <QuntisControl.h>
+#include <QuntisLamp.h>
+#include <mqtt_manager.h>
+#include <unity.h>
+#include <xn297_reference.h>
+
+#include <chrono>
+
+#define BENCH_ITERATIONS 100000
+#define BENCH_STEPS 100  // steps of the scheduler run, a full brightness sweep
+
+static const byte address[ADDRESS_LENGTH] = {0x20, 0x21, 0x01, 0x31, 0xAA};
+static const char* command = "{\"state\":\"ON\",\"brightness\":42,\"color_temp\":300}";
+
+static JsonDocument results;
+static volatile uint32_t sink;
+
+// Host time per call of body(i), i counting from 0
+template <typename Body>
+static double nsPerOp(int iterations, Body body) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        body(i);
+    }
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+void setUp() {
+    sim::Reset();
+}
+
+void tearDown() {
+}
+
+//=================================================================================================
+// Frame encoding: the address and fixed prefix once per lamp, the index/cmd tail per command.
+// A whole frame with the lookup tables against the bit by bit reference encoder.
+//=================================================================================================
+void test_frame_encode() {
+    XN297 codec;
+    XN297_Frame frame;
+    byte payload[PAYLOAD_LENGTH] = {0x00, 0x76, 0x9A, 0x31, 0x00, QUNTIS_CMD_DIM};
+    uint8_t buf[32];
+    uint8_t len = 0;
+
+    codec.XN297_SetTXAddr(address, ADDRESS_LENGTH);
+    results["frame_encode_bitwise_ns"] = nsPerOp(BENCH_ITERATIONS, [&](int i) {
+        payload[PL_INDEX] = i;
+        sink += xn297_reference::Encode(address, ADDRESS_LENGTH, payload, PAYLOAD_LENGTH, buf);
+    });
+    results["frame_encode_lut_ns"] = nsPerOp(BENCH_ITERATIONS, [&](int i) {
+        payload[PL_INDEX] = i;
+        codec.XN297_PrepareFrame(frame, payload, PAYLOAD_LENGTH, PAYLOAD_LENGTH);
+        sink += codec.XN297_FinishFrame(frame, payload);
+    });
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(buf, frame.buf, ADDRESS_LENGTH + PAYLOAD_LENGTH + 2);
+
+    results["frame_prepare_ns"] = nsPerOp(BENCH_ITERATIONS, [&](int i) {
+        codec.XN297_PrepareFrame(frame, address, payload, PL_INDEX, PAYLOAD_LENGTH);
+    });
+    results["frame_finish_ns"] = nsPerOp(BENCH_ITERATIONS, [&](int i) {
+        payload[PL_INDEX] = i;
+        len = codec.XN297_FinishFrame(frame, payload);
+    });
+    results["frame_len"] = len;
+
+    // The TX path per frame: encode it all and write it, or finish the prepared frame and queue it
+    TEST_ASSERT_TRUE(codec.begin(CE_PIN, CSN_PIN));
+    codec.setPayloadSize(ADDRESS_LENGTH + PAYLOAD_LENGTH + 2);
+    codec.XN297_SetTXAddr(address, ADDRESS_LENGTH);
+    codec.XN297_PrepareFrame(frame, address, payload, PL_INDEX, PAYLOAD_LENGTH);
+    results["frame_write_payload_ns"] = nsPerOp(BENCH_ITERATIONS / 10, [&](int i) {
+        payload[PL_INDEX] = i;
+        codec.XN297_WritePayload(payload, PAYLOAD_LENGTH);
+    });
+    results["frame_queue_ns"] = nsPerOp(BENCH_ITERATIONS / 10, [&](int i) {
+        payload[PL_INDEX] = i;
+        codec.XN297_QueueFrame(frame.buf, codec.XN297_FinishFrame(frame, payload));
+        codec.XN297_TxDrained();
+    });
+
+    uint8_t addr[ADDRESS_LENGTH];
+    uint8_t msg[PAYLOAD_LENGTH];
+    TEST_ASSERT_EQUAL(ADDRESS_LENGTH + PAYLOAD_LENGTH + 2, len);
+    TEST_ASSERT_TRUE(XN297::XN297_Decode(frame.buf, ADDRESS_LENGTH, addr, msg, PAYLOAD_LENGTH));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(payload, msg, PAYLOAD_LENGTH);
+}
+
+//=================================================================================================
+// Frame decoding, the rate bounds how much traffic a receiver can follow
+//=================================================================================================
+void test_frame_decode() {
+    const uint8_t raw[] = {0x49, 0x80, 0x4A, 0xCB, 0xA5, 0xBC, 0x8B, 0x3F, 0x81, 0xFC, 0x88, 0xCF, 0xE5};
+    uint8_t addr[ADDRESS_LENGTH];
+    uint8_t msg[PAYLOAD_LENGTH];
+
+    double ns = nsPerOp(BENCH_ITERATIONS, [&](int i) { sink += XN297::XN297_Decode(raw, ADDRESS_LENGTH, addr, msg, PAYLOAD_LENGTH); });
+    results["frame_decode_ns"] = ns;
+    results["frame_decode_per_s"] = 1e9 / ns;
+    TEST_ASSERT_TRUE(XN297::XN297_Decode(raw, ADDRESS_LENGTH, addr, msg, PAYLOAD_LENGTH));
+}
+
+void test_lamp_apply() {
+    byte payload[PAYLOAD_LENGTH] = {0x00, 0x76, 0x9A, 0x31, 0x00, QUNTIS_CMD_DIM};
+    QuntisLamp lamp(address, payload, BRIGHTNESS_STEPS, COLOR_TEMP_STEPS);
+
+    lamp.Reset(true, 0, 0);
+    results["lamp_apply_ns"] = nsPerOp(BENCH_ITERATIONS, [&](int i) {
+        payload[PL_INDEX] = i;
+        sink += lamp.Apply(payload);
+    });
+    TEST_ASSERT_EQUAL(BRIGHTNESS_STEPS, lamp.GetBrightness());
+}
+
+//=================================================================================================
+// JSON command: parsing alone and the whole of handleCommand() (targets, mailbox, journal)
+//=================================================================================================
+void test_json_command() {
+    results["json_parse_ns"] = nsPerOp(BENCH_ITERATIONS, [&](int i) {
+        JsonDocument doc;
+        deserializeJson(doc, command);
+        sink += doc["brightness"].as<int>();
+    });
+
+    QuntisControl controller;
+    TEST_ASSERT_TRUE(controller.begin());
+    MqttManager mqtt(&controller);
+    mqtt.begin();
+
+    results["handle_command_ns"] = nsPerOp(BENCH_ITERATIONS / 10, [&](int i) { mqtt.handleCommand(command); });
+    TEST_ASSERT_EQUAL(42, mqtt.getBrightness());
+    TEST_ASSERT_EQUAL(mqtt.percentToMireds(mqtt.miredsToPercent(300)), mqtt.getColorTemp());
+}
+
+//=================================================================================================
+// Percent <-> mireds, both ways for every percent
+//=================================================================================================
+void test_percent_conversion() {
+    QuntisControl controller;
+    MqttManager mqtt(&controller);
+
+    results["percent_mireds_ns"] = nsPerOp(BENCH_ITERATIONS, [&](int i) {
+        sink += mqtt.miredsToPercent(mqtt.percentToMireds(i % 101));
+    });
+
+    for (int percent = 0; percent <= 100; percent++) {
+        TEST_ASSERT_INT_WITHIN(1, percent, mqtt.miredsToPercent(mqtt.percentToMireds(percent)));
+    }
+}
+
+//=================================================================================================
+// State machine ticks: the TX scheduler per frame it puts on air, and MqttManager::loop()
+// with nothing to do and while it steps toward a target
+//=================================================================================================
+void test_tick_cost() {
+    QuntisControl controller;
+    TEST_ASSERT_TRUE(controller.begin());
+    controller.SetCarrierSense(false);
+
+    // The queue holds TX_QUEUE_SIZE steps, the rest waits for room
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < BENCH_STEPS; i++) {
+        TEST_ASSERT_TRUE(sim::RunUntil([&]() { return controller.Dim(true, true, 0, i < BENCH_STEPS - 1); }, 1000000));
+    }
+    TEST_ASSERT_TRUE(sim::RunUntil([&]() { return controller.IsTxIdle(); }, 60 * 1000000ULL));
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    size_t frames = sim::Air::GetLog().size();
+    TEST_ASSERT_GREATER_OR_EQUAL(BENCH_STEPS, frames);
+    results["tx_frame_ns"] = ns / frames;
+    results["tx_frames"] = frames;
+
+    MqttManager mqtt(&controller);
+    mqtt.begin();
+    results["loop_idle_ns"] = nsPerOp(BENCH_ITERATIONS, [&](int i) { mqtt.loop(); });
+
+    // One step per RF_STEP_DELAY_MS, the clock moves like the delay(10) in main's loop()
+    mqtt.handleCommand("{\"state\":\"ON\",\"brightness\":100}");
+    int loops = 0;
+    double total = 0;
+    while (mqtt.isTransitioning() || !controller.IsTxIdle()) {
+        total += nsPerOp(1, [&](int i) { mqtt.loop(); });
+        loops++;
+        sim::AdvanceMs(10);
+        TEST_ASSERT_LESS_THAN(100000, loops);
+    }
+    results["loop_stepping_ns"] = total / loops;
+}
+
+//=================================================================================================
+// Results file
+//=================================================================================================
+static void writeResults() {
+    const char* path = getenv("QUNTIS_BENCH_FILE");
+    if (!path) {
+        path = "bench_results.json";
+    }
+    results["iterations"] = BENCH_ITERATIONS;
+    results["version"] = DEVICE_SW_VERSION;
+    results["compiler"] = __VERSION__;
+
+    char json[2048];
+    size_t len = serializeJson(results, json, sizeof(json));
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        printf("Cannot write %s\n", path);
+        return;
+    }
+    fwrite(json, 1, len, file);
+    fputc('\n', file);
+    fclose(file);
+    printf("BENCH %s\n", json);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_frame_encode);
+    RUN_TEST(test_frame_decode);
+    RUN_TEST(test_lamp_apply);
+    RUN_TEST(test_json_command);
+    RUN_TEST(test_percent_conversion);
+    RUN_TEST(test_tick_cost);
+    writeResults();
+    return UNITY_END();
+}
@@ -0,0 +1,349 @@
+//
+//	test_main.cpp (test_end_to_end)
+//
+//	    QuntisControl and MqttManager against a lamp on the simulated air: every frame the mock
+//	    radio puts on air goes to a QuntisLamp, which does with it what the real lamp would. The
+//	    tests check where the lamp ends up and report how long each operation took from command
+//	    to final state and how many frames it put on air.
+//
+//=================================================================================================
+#include <QuntisControl.h>
+#include <QuntisLamp.h>
+#include <air.h>
+#include <mqtt_manager.h>
+#include <unity.h>
+
+#include <algorithm>
+
+#define COMMAND_TOPIC MQTT_DISCOVERY_PREFIX "/light/" MQTT_DEVICE_ID "/set"
+#define STATE_TOPIC MQTT_DISCOVERY_PREFIX "/light/" MQTT_DEVICE_ID "/state"
+
+#define LOOP_MS 10                 // clock per loop(), the delay(10) in main's loop()
+#define SETTLE_LIMIT_US 60000000ULL
+#define BLOCK_LIMIT_US 5000        // longest a loop() or a message may hold up main's loop()
+
+static const byte address[ADDRESS_LENGTH] = {0x20, 0x21, 0x01, 0x31, 0xAA};
+static const byte payload[PAYLOAD_LENGTH] = {0x00, 0x76, 0x9A, 0x31, 0x00, 0x00};
+
+// The lamp on the desk, it hears every frame that is not lost
+static QuntisLamp* lamp;
+
+void setUp() {
+    sim::Reset();
+    lamp = new QuntisLamp(address, payload, BRIGHTNESS_STEPS, COLOR_TEMP_STEPS);
+    sim::Air::Listen([](const sim::AirFrame& frame) {
+        if (!frame.lost) {
+            lamp->Accept(frame.data, frame.len);
+        }
+    });
+}
+
+void tearDown() {
+    delete lamp;
+}
+
+// Latency and frames of one operation, shown with the test results
+static void report(const char* operation, uint64_t startUs) {
+    char message[160];
+    snprintf(message, sizeof(message), "%s: %.1f ms, %u frames, %.1f ms on air", operation,
+             (sim::Now() - startUs) / 1000.0, (unsigned)sim::Air::GetLog().size(), sim::Air::GetAirtimeUs() / 1000.0);
+    TEST_MESSAGE(message);
+}
+
+// Runs MqttManager::loop() like main does until the command is applied and the lamp reached it, or
+// with exact false until the steps are on air, wherever they left the lamp
+static void settle(MqttManager& mqtt, QuntisControl& controller, bool exact = true) {
+    uint64_t limit = sim::Now() + SETTLE_LIMIT_US;
+    do {
+        mqtt.loop();
+        sim::AdvanceMs(LOOP_MS);
+        TEST_ASSERT_LESS_THAN(limit, sim::Now());
+    } while (mqtt.isTransitioning() || !controller.IsTxIdle() ||
+             (exact && lamp->GetBrightness() != mqtt.getBrightness() * BRIGHTNESS_STEPS / 100));
+}
+
+//=================================================================================================
+// QuntisControl: bursts straight from the scheduler
+//=================================================================================================
+void test_control_steps() {
+    QuntisControl controller;
+    TEST_ASSERT_TRUE(controller.begin());
+    lamp->Reset(false, 0, 0);
+
+    uint64_t start = sim::Now();
+    controller.OnOff();
+    for (int i = 0; i < 10; i++) {
+        // More steps than the queue holds, the last ones wait for room
+        TEST_ASSERT_TRUE(sim::RunUntil([&]() { return controller.Dim(true, true, 0, i < 9); }, SETTLE_LIMIT_US));
+    }
+    TEST_ASSERT_TRUE(sim::RunUntil([&]() { return controller.IsTxIdle(); }, SETTLE_LIMIT_US));
+    report("OnOff + 10 x Dim", start);
+
+    TEST_ASSERT_TRUE(lamp->GetPower());
+    TEST_ASSERT_EQUAL(10, lamp->GetBrightness());
+    TEST_ASSERT_EQUAL(11, lamp->GetStats().commands);
+}
+
+void test_control_lossy_channel() {
+    QuntisControl controller;
+    TEST_ASSERT_TRUE(controller.begin());
+    lamp->Reset(true, 0, 0);
+    sim::Air::SetLoss(0.3f);
+
+    uint64_t start = sim::Now();
+    for (int i = 0; i < 20; i++) {
+        TEST_ASSERT_TRUE(sim::RunUntil([&]() { return controller.Color(true, true, 0, i < 19); }, SETTLE_LIMIT_US));
+    }
+    TEST_ASSERT_TRUE(sim::RunUntil([&]() { return controller.IsTxIdle(); }, SETTLE_LIMIT_US));
+    report("20 x Color, 30% loss", start);
+
+    TEST_ASSERT_EQUAL(20, lamp->GetColor());
+}
+
+void test_control_ramp() {
+    QuntisControl controller;
+    TEST_ASSERT_TRUE(controller.begin());
+    controller.SetHoldRate(20);
+    lamp->SetHoldRate(20);
+    lamp->Reset(true, 0, 0);
+
+    uint64_t start = sim::Now();
+    controller.Ramp(QUNTIS_CMD_DIM, true, 1000);
+    TEST_ASSERT_TRUE(sim::RunUntil([&]() { return controller.IsTxIdle(); }, SETTLE_LIMIT_US));
+    report("1 s Ramp at 20 steps/s", start);
+
+    TEST_ASSERT_INT_WITHIN(1, 20, lamp->GetBrightness());
+    TEST_ASSERT_EQUAL(1, lamp->GetStats().commands);
+}
+
+//=================================================================================================
+// MqttManager: a command on the broker until the lamp got there
+//=================================================================================================
+void test_mqtt_brightness() {
+    QuntisControl controller;
+    TEST_ASSERT_TRUE(controller.begin());
+    MqttManager mqtt(&controller);
+    mqtt.begin();
+    lamp->Reset(mqtt.getPowerState(), mqtt.getBrightness() * BRIGHTNESS_STEPS / 100, 0);
+    sim::Air::ClearLog();
+
+    uint64_t start = sim::Now();
+    TEST_ASSERT_TRUE(PubSubClient::Receive(COMMAND_TOPIC, "{\"state\":\"ON\",\"brightness\":100}"));
+    settle(mqtt, controller);
+    report("MQTT ON, brightness 100", start);
+
+    TEST_ASSERT_TRUE(lamp->GetPower());
+    TEST_ASSERT_EQUAL(BRIGHTNESS_STEPS, lamp->GetBrightness());
+    TEST_ASSERT_TRUE(PubSubClient::GetLast(STATE_TOPIC).find("\"brightness\":100") != std::string::npos);
+}
+
+void test_mqtt_scene() {
+    QuntisControl controller;
+    TEST_ASSERT_TRUE(controller.begin());
+    MqttManager mqtt(&controller);
+    mqtt.begin();
+    int color = COLOR_TEMP_STEPS - mqtt.miredsToPercent(mqtt.getColorTemp()) * COLOR_TEMP_STEPS / 100;
+    lamp->Reset(mqtt.getPowerState(), mqtt.getBrightness() * BRIGHTNESS_STEPS / 100, color);
+    TEST_ASSERT_TRUE(PubSubClient::Receive(COMMAND_TOPIC, "{\"state\":\"ON\"}"));
+    settle(mqtt, controller);
+    sim::Air::ClearLog();
+
+    // Both axes at once, warmest (500 mireds) is model color 0
+    uint64_t start = sim::Now();
+    TEST_ASSERT_TRUE(PubSubClient::Receive(COMMAND_TOPIC, "{\"state\":\"ON\",\"brightness\":20,\"color_temp\":500}"));
+    settle(mqtt, controller);
+    report("MQTT brightness 20, color_temp 500", start);
+
+    TEST_ASSERT_TRUE(lamp->GetPower());
+    TEST_ASSERT_EQUAL(20 * BRIGHTNESS_STEPS / 100, lamp->GetBrightness());
+    TEST_ASSERT_EQUAL(0, lamp->GetColor());
+}
+
+void test_mqtt_repeated_on() {
+    QuntisControl controller;
+    TEST_ASSERT_TRUE(controller.begin());
+    MqttManager mqtt(&controller);
+    mqtt.begin();
+    lamp->Reset(mqtt.getPowerState(), mqtt.getBrightness() * BRIGHTNESS_STEPS / 100, 0);
+
+    // HA sends the state with every brightness change, the lamp must not toggle on the repeats
+    for (int brightness = 60; brightness <= 80; brightness += 10) {
+        char command[64];
+        snprintf(command, sizeof(command), "{\"state\":\"ON\",\"brightness\":%d}", brightness);
+        TEST_ASSERT_TRUE(PubSubClient::Receive(COMMAND_TOPIC, command));
+        settle(mqtt, controller);
+        TEST_ASSERT_TRUE(lamp->GetPower());
+        TEST_ASSERT_EQUAL(brightness * BRIGHTNESS_STEPS / 100, lamp->GetBrightness());
+    }
+}
+
+// HA repeats the state and moves other axes without a transition, a running brightness transition
+// keeps its pace through both
+void test_mqtt_transition_keeps_pace() {
+    QuntisControl controller;
+    TEST_ASSERT_TRUE(controller.begin());
+    MqttManager mqtt(&controller);
+    mqtt.begin();
+    int color = COLOR_TEMP_STEPS - mqtt.miredsToPercent(mqtt.getColorTemp()) * COLOR_TEMP_STEPS / 100;
+    lamp->Reset(mqtt.getPowerState(), mqtt.getBrightness() * BRIGHTNESS_STEPS / 100, color);
+    TEST_ASSERT_TRUE(PubSubClient::Receive(COMMAND_TOPIC, "{\"state\":\"ON\",\"brightness\":0}"));
+    settle(mqtt, controller);
+
+    uint64_t start = sim::Now();
+    TEST_ASSERT_TRUE(PubSubClient::Receive(COMMAND_TOPIC, "{\"state\":\"ON\",\"brightness\":100,\"transition\":10}"));
+    struct {
+        uint64_t atUs;
+        const char* json;
+    } during[] = {{2000000, "{\"state\":\"ON\"}"}, {4000000, "{\"state\":\"ON\",\"color_temp\":500}"}, {5000000, nullptr}};
+    for (const auto& command : during) {
+        while (sim::Now() - start < command.atUs) {
+            mqtt.loop();
+            sim::AdvanceMs(LOOP_MS);
+        }
+        if (command.json) {
+            TEST_ASSERT_TRUE(PubSubClient::Receive(COMMAND_TOPIC, command.json));
+        }
+    }
+    TEST_ASSERT_INT_WITHIN(BRIGHTNESS_STEPS / 10, BRIGHTNESS_STEPS / 2, lamp->GetBrightness());
+
+    settle(mqtt, controller);
+    report("10 s transition, state and color_temp in between", start);
+    TEST_ASSERT_EQUAL(BRIGHTNESS_STEPS, lamp->GetBrightness());
+    TEST_ASSERT_EQUAL(0, lamp->GetColor());
+    TEST_ASSERT_INT_WITHIN(500, 10000, (sim::Now() - start) / 1000);
+}
+
+// The lamp holds 10% faster than the rate we know: holds drift, a hold into an end stop gets it back
+void test_mqtt_hold_error() {
+    QuntisControl controller;
+    TEST_ASSERT_TRUE(controller.begin());
+    controller.SetHoldRate(20);
+    lamp->SetHoldRate(22);
+    MqttManager mqtt(&controller);
+    mqtt.begin();
+    lamp->Reset(mqtt.getPowerState(), mqtt.getBrightness() * BRIGHTNESS_STEPS / 100, 0);
+    TEST_ASSERT_TRUE(PubSubClient::Receive(COMMAND_TOPIC, "{\"state\":\"ON\",\"brightness\":80}"));
+    settle(mqtt, controller, false);
+    TEST_ASSERT_NOT_EQUAL(80 * BRIGHTNESS_STEPS / 100, lamp->GetBrightness());
+    TEST_ASSERT_INT_WITHIN(3, 80 * BRIGHTNESS_STEPS / 100, lamp->GetBrightness());
+
+    TEST_ASSERT_TRUE(PubSubClient::Receive(COMMAND_TOPIC, "{\"state\":\"ON\",\"brightness\":0}"));
+    settle(mqtt, controller);
+    TEST_ASSERT_EQUAL(0, lamp->GetBrightness());
+
+    TEST_ASSERT_TRUE(PubSubClient::Receive(COMMAND_TOPIC, "{\"state\":\"ON\",\"brightness\":100}"));
+    settle(mqtt, controller);
+    TEST_ASSERT_EQUAL(BRIGHTNESS_STEPS, lamp->GetBrightness());
+}
+
+// Sim time only moves inside loop() and the callback when they delay(), a blocking step loop would show
+void test_mqtt_loop_does_not_block() {
+    QuntisControl controller;
+    TEST_ASSERT_TRUE(controller.begin());
+    MqttManager mqtt(&controller);
+    mqtt.begin();
+    int color = COLOR_TEMP_STEPS - mqtt.miredsToPercent(mqtt.getColorTemp()) * COLOR_TEMP_STEPS / 100;
+    lamp->Reset(mqtt.getPowerState(), mqtt.getBrightness() * BRIGHTNESS_STEPS / 100, color);
+    uint64_t longestUs = 0;
+
+    // Full range on both axes, retargeted a second into the ramp
+    uint64_t start = sim::Now();
+    uint64_t before = sim::Now();
+    TEST_ASSERT_TRUE(PubSubClient::Receive(COMMAND_TOPIC, "{\"state\":\"ON\",\"brightness\":100,\"color_temp\":153}"));
+    longestUs = std::max(longestUs, sim::Now() - before);
+    bool retargeted = false;
+    uint64_t limit = sim::Now() + SETTLE_LIMIT_US;
+    do {
+        if (!retargeted && sim::Now() - start >= 1000000ULL) {
+            TEST_ASSERT_TRUE(mqtt.isTransitioning());
+            before = sim::Now();
+            TEST_ASSERT_TRUE(PubSubClient::Receive(COMMAND_TOPIC, "{\"state\":\"ON\",\"brightness\":10}"));
+            longestUs = std::max(longestUs, sim::Now() - before);
+            retargeted = true;
+        }
+        before = sim::Now();
+        mqtt.loop();
+        longestUs = std::max(longestUs, sim::Now() - before);
+        sim::AdvanceMs(LOOP_MS);
+        TEST_ASSERT_LESS_THAN(limit, sim::Now());
+    } while (!retargeted || mqtt.isTransitioning() || !controller.IsTxIdle());
+
+    char message[128];
+    snprintf(message, sizeof(message), "full range, retargeted after 1 s: %.1f ms, longest loop() %.3f ms",
+             (sim::Now() - start) / 1000.0, longestUs / 1000.0);
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_LESS_OR_EQUAL(BLOCK_LIMIT_US, longestUs);
+    TEST_ASSERT_EQUAL(10, mqtt.getBrightness());
+    TEST_ASSERT_EQUAL(10 * BRIGHTNESS_STEPS / 100, lamp->GetBrightness());
+    TEST_ASSERT_EQUAL(COLOR_TEMP_STEPS, lamp->GetColor());  // coldest
+}
+
+void test_mqtt_follows_remote() {
+    QuntisControl controller;
+    TEST_ASSERT_TRUE(controller.begin());
+    MqttManager mqtt(&controller);
+    mqtt.begin();
+    lamp->Reset(mqtt.getPowerState(), mqtt.getBrightness() * BRIGHTNESS_STEPS / 100, 0);
+
+    // The original remote is one more transmitter with the same address and its own index
+    QuntisControl remote;
+    TEST_ASSERT_TRUE(remote.begin());
+    remote.SetIndex(0x80);
+    remote.OnOff();
+    for (int i = 0; i < 5; i++) {
+        remote.Dim(false);
+    }
+    int before = mqtt.getBrightness();
+    uint64_t limit = sim::Now() + SETTLE_LIMIT_US;
+    while (!remote.IsTxIdle() && sim::Now() < limit) {
+        mqtt.loop();
+        sim::AdvanceMs(LOOP_MS);
+    }
+    mqtt.loop();
+
+    TEST_ASSERT_TRUE(lamp->GetPower());
+    TEST_ASSERT_TRUE(mqtt.getPowerState());
+    TEST_ASSERT_EQUAL(before - 5 * 100 / BRIGHTNESS_STEPS, mqtt.getBrightness());
+    TEST_ASSERT_EQUAL(lamp->GetBrightness(), mqtt.getBrightness() * BRIGHTNESS_STEPS / 100);
+}
+
+// A held button on the remote sets the cadence of our own ramps
+void test_mqtt_learns_hold_gap() {
+    QuntisControl controller;
+    TEST_ASSERT_TRUE(controller.begin());
+    MqttManager mqtt(&controller);
+    mqtt.begin();
+
+    QuntisControl remote;
+    TEST_ASSERT_TRUE(remote.begin());
+    remote.SetIndex(0x80);
+    remote.SetHoldGap(8000);
+    remote.Ramp(QUNTIS_CMD_DIM, false, 500);
+    remote.Dim(true);
+    uint64_t limit = sim::Now() + SETTLE_LIMIT_US;
+    while (!remote.IsTxIdle() && sim::Now() < limit) {
+        mqtt.loop();
+        sim::AdvanceMs(LOOP_MS);
+    }
+    mqtt.loop();
+
+    // Frames are timed when loop() polls them, over 60 of them that's within a few percent
+    TEST_ASSERT_INT_WITHIN(250, 8000, (int)controller.GetHoldGap());
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_control_steps);
+    RUN_TEST(test_control_lossy_channel);
+    RUN_TEST(test_control_ramp);
+    RUN_TEST(test_mqtt_brightness);
+    RUN_TEST(test_mqtt_scene);
+    RUN_TEST(test_mqtt_repeated_on);
+    RUN_TEST(test_mqtt_transition_keeps_pace);
+    RUN_TEST(test_mqtt_hold_error);
+    RUN_TEST(test_mqtt_loop_does_not_block);
+    RUN_TEST(test_mqtt_follows_remote);
+    RUN_TEST(test_mqtt_learns_hold_gap);
+    return UNITY_END();
+}
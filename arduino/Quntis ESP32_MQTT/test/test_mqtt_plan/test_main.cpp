@@ -0,0 +1,162 @@
+//
+//	test_main.cpp (test_mqtt_plan)
+//
+//	    MqttManager turns each command into the RF operations that take the lamp from where it
+//	    is to the desired state: a toggle only when the power differs, and the step deltas.
+//	    The tests check the plan of every command and that the lamp got just that.
+//
+//=================================================================================================
+#include <QuntisControl.h>
+#include <QuntisLamp.h>
+#include <air.h>
+#include <mqtt_manager.h>
+#include <unity.h>
+
+#define COMMAND_TOPIC MQTT_DISCOVERY_PREFIX "/light/" MQTT_DEVICE_ID "/set"
+
+#define LOOP_MS 10  // clock per loop(), the delay(10) in main's loop()
+#define SETTLE_LIMIT_US 60000000ULL
+#define COMMAND_WAIT_MS 200  // past the debounce of a command, COMMAND_SETTLE_MS in mqtt_manager.cpp
+
+static const byte address[ADDRESS_LENGTH] = {0x20, 0x21, 0x01, 0x31, 0xAA};
+static const byte payload[PAYLOAD_LENGTH] = {0x00, 0x76, 0x9A, 0x31, 0x00, 0x00};
+
+static QuntisLamp* lamp;
+static QuntisControl* controller;
+static MqttManager* mqtt;
+
+void setUp() {
+    sim::Reset();
+    lamp = new QuntisLamp(address, payload, BRIGHTNESS_STEPS, COLOR_TEMP_STEPS);
+    sim::Air::Listen([](const sim::AirFrame& frame) {
+        if (!frame.lost) {
+            lamp->Accept(frame.data, frame.len);
+        }
+    });
+    controller = new QuntisControl();
+    TEST_ASSERT_TRUE(controller->begin());
+    mqtt = new MqttManager(controller);
+    mqtt->begin();
+    int color = COLOR_TEMP_STEPS - mqtt->miredsToPercent(mqtt->getColorTemp()) * COLOR_TEMP_STEPS / 100;
+    lamp->Reset(mqtt->getPowerState(), mqtt->getBrightness() * BRIGHTNESS_STEPS / 100, color);
+}
+
+void tearDown() {
+    delete mqtt;
+    delete controller;
+    delete lamp;
+}
+
+// Runs MqttManager's loop until the command settled and the lamp got there (an off lamp keeps its
+// steps for later)
+static void settle() {
+    uint64_t start = sim::Now();
+    do {
+        mqtt->loop();
+        sim::AdvanceMs(LOOP_MS);
+        TEST_ASSERT_LESS_THAN(start + SETTLE_LIMIT_US, sim::Now());
+    } while (sim::Now() - start < COMMAND_WAIT_MS * 1000ULL || (mqtt->getPowerState() && mqtt->isTransitioning()) ||
+             !controller->IsTxIdle());
+}
+
+// Hands the command to MqttManager, settles it and returns the plan
+static MqttManager::Plan command(const char* json) {
+    TEST_ASSERT_TRUE(PubSubClient::Receive(COMMAND_TOPIC, json));
+    MqttManager::Plan plan = mqtt->getLastPlan();
+    settle();
+    return plan;
+}
+
+static void assertPlan(bool toggle, int dimSteps, int colorSteps, const MqttManager::Plan& plan) {
+    TEST_ASSERT_EQUAL(toggle, plan.toggle);
+    TEST_ASSERT_EQUAL(dimSteps, plan.dimSteps);
+    TEST_ASSERT_EQUAL(colorSteps, plan.colorSteps);
+}
+
+//=================================================================================================
+// Power
+//=================================================================================================
+// HA sends the state with every change, only the first ON toggles
+void test_repeated_on() {
+    assertPlan(true, 0, 0, command("{\"state\":\"ON\"}"));
+    uint32_t commands = lamp->GetStats().commands;
+
+    for (int i = 0; i < 3; i++) {
+        assertPlan(false, 0, 0, command("{\"state\":\"ON\"}"));
+    }
+    TEST_ASSERT_TRUE(lamp->GetPower());
+    TEST_ASSERT_EQUAL(commands, lamp->GetStats().commands);
+}
+
+void test_repeated_off() {
+    assertPlan(false, 0, 0, command("{\"state\":\"OFF\"}"));
+    assertPlan(true, 0, 0, command("{\"state\":\"ON\"}"));
+    assertPlan(true, 0, 0, command("{\"state\":\"OFF\"}"));
+    assertPlan(false, 0, 0, command("{\"state\":\"OFF\"}"));
+    TEST_ASSERT_FALSE(lamp->GetPower());
+    TEST_ASSERT_EQUAL(2, lamp->GetStats().commands);
+}
+
+//=================================================================================================
+// Steps
+//=================================================================================================
+// Only the difference to the tracked steps goes out
+void test_step_deltas() {
+    command("{\"state\":\"ON\",\"brightness\":50}");
+    uint32_t commands = lamp->GetStats().commands;
+
+    assertPlan(false, 10 * BRIGHTNESS_STEPS / 100, 0, command("{\"state\":\"ON\",\"brightness\":60}"));
+    assertPlan(false, 0, 0, command("{\"state\":\"ON\",\"brightness\":60}"));
+    assertPlan(false, -20 * BRIGHTNESS_STEPS / 100, 0, command("{\"state\":\"ON\",\"brightness\":40}"));
+    TEST_ASSERT_EQUAL(commands + 30 * BRIGHTNESS_STEPS / 100, lamp->GetStats().commands);
+
+    // Warmest is the last color step
+    int color = mqtt->miredsToPercent(mqtt->getColorTemp()) * COLOR_TEMP_STEPS / 100;
+    assertPlan(false, 0, COLOR_TEMP_STEPS - color, command("{\"state\":\"ON\",\"color_temp\":500}"));
+    TEST_ASSERT_EQUAL(0, lamp->GetColor());
+}
+
+// Off, the lamp ignores steps: nothing goes out until it is on again
+void test_steps_while_off() {
+    command("{\"state\":\"OFF\"}");
+    int brightness = lamp->GetBrightness();
+
+    assertPlan(false, 0, 0, command("{\"state\":\"OFF\",\"brightness\":80}"));
+    TEST_ASSERT_EQUAL(brightness, lamp->GetBrightness());
+    TEST_ASSERT_EQUAL(0, lamp->GetStats().commands);
+
+    assertPlan(true, 80 * BRIGHTNESS_STEPS / 100 - brightness, 0, command("{\"state\":\"ON\"}"));
+    TEST_ASSERT_EQUAL(80 * BRIGHTNESS_STEPS / 100, lamp->GetBrightness());
+}
+
+// A command that finds the RF queue full goes out once the radio made room
+static MqttManager::Plan commandOnFullQueue(const char* json) {
+    TEST_ASSERT_TRUE(PubSubClient::Receive(COMMAND_TOPIC, json));
+    MqttManager::Plan plan = mqtt->getLastPlan();
+    sim::AdvanceMs(COMMAND_WAIT_MS);  // past the debounce, the next loop() applies it
+    for (int i = 0; i < TX_QUEUE_SIZE; i++) {
+        TEST_ASSERT_TRUE(controller->Dim(i & 1));  // down and up again
+    }
+    settle();
+    return plan;
+}
+
+void test_full_queue() {
+    assertPlan(true, 0, 0, command("{\"state\":\"ON\",\"brightness\":50}"));
+    int brightness = lamp->GetBrightness();
+
+    assertPlan(false, 10 * BRIGHTNESS_STEPS / 100, 0, commandOnFullQueue("{\"state\":\"ON\",\"brightness\":60}"));
+    assertPlan(true, 0, 0, commandOnFullQueue("{\"state\":\"OFF\"}"));
+    TEST_ASSERT_FALSE(lamp->GetPower());
+    TEST_ASSERT_EQUAL(brightness + 10 * BRIGHTNESS_STEPS / 100, lamp->GetBrightness());
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_repeated_on);
+    RUN_TEST(test_repeated_off);
+    RUN_TEST(test_step_deltas);
+    RUN_TEST(test_steps_while_off);
+    RUN_TEST(test_full_queue);
+    return UNITY_END();
+}
@@ -0,0 +1,219 @@
+//
+//	test_main.cpp (test_quntis_control)
+//
+//	    The TX scheduler on the simulated clock: commands return at once, the esp_timer ticks
+//	    put the repeats on air at their gap, and the done callback and jitter histogram report
+//	    what went out. Several lamps share the radio, their bursts interleave.
+//
+//=================================================================================================
+#include <QuntisControl.h>
+#include <QuntisLamp.h>
+#include <air.h>
+#include <unity.h>
+
+#include <utility>
+#include <vector>
+
+#define RUN_LIMIT_US 10000000ULL
+
+void setUp() {
+    sim::Reset();
+}
+
+void tearDown() {
+}
+
+//=================================================================================================
+// Scheduler
+//=================================================================================================
+void test_commands_do_not_block() {
+    QuntisControl controller;
+    TEST_ASSERT_TRUE(controller.begin());
+
+    uint64_t start = sim::Now();
+    controller.OnOff();
+    for (int i = 0; i < TX_QUEUE_SIZE - 1; i++) {
+        controller.Dim(true);
+    }
+    TEST_ASSERT_EQUAL(start, sim::Now());
+    TEST_ASSERT_FALSE(controller.IsTxIdle());
+    TEST_ASSERT_EQUAL(0, sim::Air::GetLog().size());
+
+    TEST_ASSERT_TRUE(sim::RunUntil([&]() { return controller.IsTxIdle(); }, RUN_LIMIT_US));
+    TEST_ASSERT_EQUAL(TX_QUEUE_SIZE * TX_REPEAT, sim::Air::GetLog().size());
+}
+
+// Frames of a burst go out TX_REPEAT_GAP_US apart, the simulated clock has no jitter
+void test_repeat_gap() {
+    QuntisControl controller;
+    TEST_ASSERT_TRUE(controller.begin());
+    controller.SetCarrierSense(false);
+
+    controller.OnOff();
+    controller.Dim(false);
+    TEST_ASSERT_TRUE(sim::RunUntil([&]() { return controller.IsTxIdle(); }, RUN_LIMIT_US));
+
+    const std::vector<sim::AirFrame>& log = sim::Air::GetLog();
+    TEST_ASSERT_EQUAL(2 * TX_REPEAT, log.size());
+    for (size_t i = 1; i < log.size(); i++) {
+        if (i % TX_REPEAT != 0) {
+            TEST_ASSERT_INT_WITHIN(TX_FIFO_POLL_US, TX_REPEAT_GAP_US, (int)(log[i].startUs - log[i - 1].startUs));
+        }
+    }
+
+    const uint32_t* hist = controller.GetJitterHistogram();
+    TEST_ASSERT_EQUAL(2 * (TX_REPEAT - 1), hist[0]);
+    for (int bucket = 1; bucket < TX_JITTER_BUCKETS; bucket++) {
+        TEST_ASSERT_EQUAL(0, hist[bucket]);
+    }
+}
+
+// Once per command, in order, from the timer
+void test_done_callback() {
+    QuntisControl controller;
+    TEST_ASSERT_TRUE(controller.begin());
+    std::vector<std::pair<uint8_t, byte>> done;
+    bool inTimer = true;
+    controller.SetTxDoneCallback([&](uint8_t lamp, byte cmd) {
+        done.push_back(std::make_pair(lamp, cmd));
+        inTimer = inTimer && sim::InEvent();
+    });
+
+    controller.OnOff();
+    controller.Dim(true);
+    controller.Color(false);
+    TEST_ASSERT_TRUE(sim::RunUntil([&]() { return controller.IsTxIdle(); }, RUN_LIMIT_US));
+
+    TEST_ASSERT_EQUAL(3, done.size());
+    TEST_ASSERT_EQUAL_HEX8(QUNTIS_CMD_ONOFF, done[0].second);
+    TEST_ASSERT_EQUAL_HEX8(QUNTIS_CMD_DIM | QUNTIS_CMD_UP, done[1].second);
+    TEST_ASSERT_EQUAL_HEX8(QUNTIS_CMD_COLOR | QUNTIS_CMD_DOWN, done[2].second);
+    TEST_ASSERT_TRUE(inTimer);
+}
+
+// A caller a whole queue ahead is turned away at once, the refused command uses no index
+void test_full_queue_refuses() {
+    QuntisControl controller;
+    TEST_ASSERT_TRUE(controller.begin());
+    uint64_t start = sim::Now();
+    for (int i = 0; i < TX_QUEUE_SIZE; i++) {
+        TEST_ASSERT_TRUE(controller.Dim(true, false));
+    }
+    TEST_ASSERT_FALSE(controller.Dim(true, false));
+    TEST_ASSERT_EQUAL(start, sim::Now());
+    TEST_ASSERT_EQUAL(TX_QUEUE_SIZE, controller.GetIndex());
+
+    TEST_ASSERT_TRUE(sim::RunUntil([&]() { return controller.IsTxIdle(); }, RUN_LIMIT_US));
+    TEST_ASSERT_EQUAL(TX_QUEUE_SIZE, sim::Air::GetLog().size());
+    TEST_ASSERT_EQUAL(TX_QUEUE_SIZE, controller.GetIndex());
+    TEST_ASSERT_TRUE(controller.Dim(true, false));
+}
+
+// A busy channel holds the burst back, the listen before it doesn't wait inside the timer
+void test_carrier_sense() {
+    QuntisControl controller;
+    TEST_ASSERT_TRUE(controller.begin());
+    controller.SetCarrierSense(true);
+    uint64_t busyUntil = sim::Now() + 3000;
+    sim::Air::SetInterference([busyUntil](uint64_t us) { return us < busyUntil; });
+
+    controller.OnOff();
+    TEST_ASSERT_TRUE(sim::RunUntil([&]() { return controller.IsTxIdle(); }, RUN_LIMIT_US));
+
+    const std::vector<sim::AirFrame>& log = sim::Air::GetLog();
+    TEST_ASSERT_EQUAL(TX_REPEAT, log.size());
+    TEST_ASSERT_GREATER_OR_EQUAL(busyUntil, log[0].startUs);
+    for (const sim::AirFrame& frame : log) {
+        TEST_ASSERT_FALSE(frame.lost);
+    }
+
+    const QuntisControl::CarrierStats& stats = controller.GetCarrierStats();
+    TEST_ASSERT_EQUAL(1, stats.bursts);
+    TEST_ASSERT_EQUAL(1, stats.deferred);
+    TEST_ASSERT_EQUAL(0, stats.forced);
+    TEST_ASSERT_EQUAL(stats.busy + 1, stats.senses);
+
+    // Only the switch back to TX after each listen waits, RF24's txDelay in stopListening()
+    TEST_ASSERT_EQUAL(stats.senses * RF24_TX_DELAY_US, sim::GetBlockedUs());
+}
+
+//=================================================================================================
+// Lamps sharing the radio
+//=================================================================================================
+static const byte lampAddress[MAX_LAMPS - 1][ADDRESS_LENGTH] = {
+    {0x20, 0x21, 0x01, 0x31, 0xAB}, {0x20, 0x21, 0x01, 0x31, 0xAC}, {0x20, 0x21, 0x01, 0x31, 0xAD}};
+
+// Time from the first command until the radio is idle again
+static uint64_t dimAll(QuntisControl& controller, int steps) {
+    uint64_t start = sim::Now();
+    for (int step = 0; step < steps; step++) {
+        for (uint8_t lamp = 0; lamp < controller.GetLampCount(); lamp++) {
+            TEST_ASSERT_TRUE(sim::RunUntil([&]() { return controller.Dim(true, true, lamp, step < steps - 1); }, RUN_LIMIT_US));
+        }
+    }
+    TEST_ASSERT_TRUE(sim::RunUntil([&]() { return controller.IsTxIdle(); }, RUN_LIMIT_US));
+    return sim::Now() - start;
+}
+
+void test_lamps_interleave() {
+    const int steps = 10;
+
+    QuntisControl single;
+    TEST_ASSERT_TRUE(single.begin());
+    uint64_t singleUs = dimAll(single, steps);
+    uint64_t singleAirUs = sim::Air::GetAirtimeUs();
+    sim::Air::ClearLog();
+
+    QuntisControl controller;
+    std::vector<QuntisLamp*> lamps;
+    lamps.push_back(new QuntisLamp(controller.GetAddress(), controller.GetPayload(), 100, 50));
+    for (int i = 0; i < MAX_LAMPS - 1; i++) {
+        TEST_ASSERT_EQUAL(i + 1, controller.AddLamp(lampAddress[i], controller.GetPayload()));
+        lamps.push_back(new QuntisLamp(lampAddress[i], controller.GetPayload(), 100, 50));
+    }
+    TEST_ASSERT_EQUAL(-1, controller.AddLamp(lampAddress[0], controller.GetPayload()));
+    TEST_ASSERT_TRUE(controller.begin());
+    std::vector<int> order;
+    sim::Air::Listen([&](const sim::AirFrame& frame) {
+        for (size_t i = 0; i < lamps.size(); i++) {
+            if (lamps[i]->Accept(frame.data, frame.len)) {
+                order.push_back(i);
+            }
+        }
+    });
+    for (QuntisLamp* lamp : lamps) {
+        lamp->Reset(true, 0, 0);
+    }
+
+    uint64_t allUs = dimAll(controller, steps);
+    char message[128];
+    snprintf(message, sizeof(message), "dim %d lamps %d steps: %.1f ms (one lamp %.1f ms), %.1f ms on air (one lamp %.1f ms)",
+             MAX_LAMPS, steps, allUs / 1000.0, singleUs / 1000.0, sim::Air::GetAirtimeUs() / 1000.0, singleAirUs / 1000.0);
+    TEST_MESSAGE(message);
+
+    // Every lamp got each of its steps once, round robin, and ignored the frames for the others
+    for (QuntisLamp* lamp : lamps) {
+        TEST_ASSERT_EQUAL(steps, lamp->GetBrightness());
+        TEST_ASSERT_EQUAL((MAX_LAMPS - 1) * lamp->GetStats().frames / MAX_LAMPS, lamp->GetStats().foreign);
+        delete lamp;
+    }
+    TEST_ASSERT_EQUAL(MAX_LAMPS * steps, order.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        TEST_ASSERT_EQUAL(i % MAX_LAMPS, order[i]);
+    }
+
+    // Same frames per lamp, and the bursts share the repeat gaps instead of queueing behind each other
+    TEST_ASSERT_EQUAL(MAX_LAMPS * singleAirUs, sim::Air::GetAirtimeUs());
+    TEST_ASSERT_LESS_THAN(singleUs * 3 / 2, allUs);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_commands_do_not_block);
+    RUN_TEST(test_repeat_gap);
+    RUN_TEST(test_done_callback);
+    RUN_TEST(test_full_queue_refuses);
+    RUN_TEST(test_carrier_sense);
+    RUN_TEST(test_lamps_interleave);
+    return UNITY_END();
+}
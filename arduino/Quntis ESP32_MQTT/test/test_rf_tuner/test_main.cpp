@@ -0,0 +1,169 @@
+//
+//	test_main.cpp (test_rf_tuner)
+//
+//	    RfTuner against the simulated air: the trial sends DIM bursts to a lamp model behind a
+//	    lossy channel with WiFi bursts on it, so short gaps and few repeats lose commands like
+//	    on the desk. The result has to get every command through and survive in NVS.
+//
+//=================================================================================================
+#include <QuntisControl.h>
+#include <QuntisLamp.h>
+#include <RfTuner.h>
+#include <air.h>
+#include <unity.h>
+
+#define TUNE_COMMANDS 20
+#define RUN_LIMIT_US 10000000ULL
+
+// WiFi on the channel: busy for WIFI_BURST_US out of every WIFI_PERIOD_US
+#define WIFI_PERIOD_US 10000
+#define WIFI_BURST_US 2000
+
+static const byte address[ADDRESS_LENGTH] = {0x20, 0x21, 0x01, 0x31, 0xAA};
+static const byte payload[PAYLOAD_LENGTH] = {0x00, 0x76, 0x9A, 0x31, 0x00, 0x00};
+
+static QuntisControl* controller;
+static QuntisLamp* lamp;  // the one of the running trial
+
+void setUp() {
+    sim::Reset();
+    controller = new QuntisControl();
+    TEST_ASSERT_TRUE(controller->begin());
+    controller->SetCarrierSense(false);  // the tuner is what has to get around the bursts
+    lamp = nullptr;
+    sim::Air::Listen([](const sim::AirFrame& frame) {
+        if (lamp && !frame.lost) {
+            lamp->Accept(frame.data, frame.len);
+        }
+    });
+}
+
+void tearDown() {
+    delete controller;
+}
+
+// What a trial in main does, with the lamp model hearing the simulated air
+static float simTrial(uint8_t repeat, uint32_t gap) {
+    QuntisLamp trialLamp(address, payload, TUNE_COMMANDS, TUNE_COMMANDS);
+    lamp = &trialLamp;
+
+    controller->SetRepeatCount(repeat);
+    controller->SetRepeatGap(gap);
+    lamp->Reset(true, TUNE_COMMANDS / 2, 0);
+    for (int i = 0; i < TUNE_COMMANDS; i++) {
+        TEST_ASSERT_TRUE(sim::RunUntil([i]() { return controller->Dim(i & 1); }, RUN_LIMIT_US));
+    }
+    TEST_ASSERT_TRUE(sim::RunUntil([]() { return controller->IsTxIdle(); }, RUN_LIMIT_US));
+
+    lamp = nullptr;
+    return 1.0f - (float)trialLamp.GetStats().commands / TUNE_COMMANDS;
+}
+
+static void report(const char* channel, const RfTuner::Result& result, RfTuner& tuner) {
+    char message[128];
+    snprintf(message, sizeof(message), "%s: repeat=%d gap=%luus after %d trials", channel, result.repeat,
+             (unsigned long)result.gap, tuner.GetTrialCount());
+    TEST_MESSAGE(message);
+}
+
+//=================================================================================================
+// Tune
+//=================================================================================================
+// Nothing lost, both go down to the floor
+void test_clean_channel() {
+    RfTuner tuner(simTrial);
+    RfTuner::Result result = tuner.Tune(TX_REPEAT, TX_REPEAT_GAP_US);
+    report("clean channel", result, tuner);
+
+    TEST_ASSERT_TRUE(result.ok);
+    TEST_ASSERT_EQUAL(1 + TUNE_REPEAT_MARGIN, result.repeat);
+    TEST_ASSERT_EQUAL(TUNE_MIN_GAP_US, result.gap);
+}
+
+// Random loss and WiFi bursts: the repeats must outlast a burst, so neither goes to the floor
+void test_lossy_channel() {
+    sim::Air::SetLoss(0.15f);
+    sim::Air::SetInterference([](uint64_t us) { return us % WIFI_PERIOD_US < WIFI_BURST_US; });
+
+    RfTuner tuner(simTrial);
+    RfTuner::Result result = tuner.Tune(TX_REPEAT, TX_REPEAT_GAP_US);
+    report("15% loss + WiFi bursts", result, tuner);
+
+    TEST_ASSERT_TRUE(result.ok);
+    TEST_ASSERT_LESS_OR_EQUAL(TX_REPEAT, result.repeat);
+    TEST_ASSERT_GREATER_THAN(1 + TUNE_REPEAT_MARGIN, result.repeat);
+    TEST_ASSERT_GREATER_THAN(TUNE_MIN_GAP_US, result.gap);
+    TEST_ASSERT_LESS_OR_EQUAL(TX_REPEAT_GAP_US, result.gap);
+
+    // With the margin on top of the lowest passing point a longer run gets through too, give or take
+    // the odd command a 20 command trial can't rule out
+    float lost = 0;
+    for (int run = 0; run < 5; run++) {
+        lost += simTrial(result.repeat, result.gap) * TUNE_COMMANDS;
+    }
+    TEST_ASSERT_LESS_OR_EQUAL(1, (int)(lost + 0.5f));
+}
+
+// Losing commands at the defaults already, the tuner doesn't go lower
+void test_dead_channel() {
+    sim::Air::SetLoss(1.0f);
+
+    RfTuner tuner(simTrial);
+    RfTuner::Result result = tuner.Tune(TX_REPEAT, TX_REPEAT_GAP_US);
+
+    TEST_ASSERT_FALSE(result.ok);
+    TEST_ASSERT_EQUAL(TX_REPEAT, result.repeat);
+    TEST_ASSERT_EQUAL(TX_REPEAT_GAP_US, result.gap);
+    TEST_ASSERT_EQUAL(1, tuner.GetTrialCount());
+}
+
+// One trial at a time like main's loop() runs them, the same search as Tune()
+void test_stepwise() {
+    RfTuner tuner;
+    uint8_t repeat;
+    uint32_t gap;
+    tuner.Start(TX_REPEAT, TX_REPEAT_GAP_US);
+    while (tuner.Next(repeat, gap)) {
+        tuner.Report(simTrial(repeat, gap));
+    }
+    RfTuner::Result result = tuner.GetResult();
+
+    RfTuner reference(simTrial);
+    RfTuner::Result expected = reference.Tune(TX_REPEAT, TX_REPEAT_GAP_US);
+    TEST_ASSERT_TRUE(result.ok);
+    TEST_ASSERT_EQUAL(expected.repeat, result.repeat);
+    TEST_ASSERT_EQUAL(expected.gap, result.gap);
+    TEST_ASSERT_EQUAL(reference.GetTrialCount(), tuner.GetTrialCount());
+    TEST_ASSERT_FALSE(tuner.Next(repeat, gap));
+}
+
+//=================================================================================================
+// NVS
+//=================================================================================================
+void test_saved_result() {
+    sim::Air::SetLoss(0.2f);
+    RfTuner tuner(simTrial);
+    RfTuner::Result result = tuner.Tune(TX_REPEAT, TX_REPEAT_GAP_US);
+    result.loss = 0.2f;
+
+    RfTuner::Result loaded;
+    TEST_ASSERT_FALSE(RfTuner::Load(loaded));
+    RfTuner::Save(result);
+    TEST_ASSERT_TRUE(RfTuner::Load(loaded));
+    TEST_ASSERT_EQUAL(result.repeat, loaded.repeat);
+    TEST_ASSERT_EQUAL(result.gap, loaded.gap);
+    TEST_ASSERT_EQUAL_FLOAT(result.loss, loaded.loss);
+
+    RfTuner::Clear();
+    TEST_ASSERT_FALSE(RfTuner::Load(loaded));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_clean_channel);
+    RUN_TEST(test_lossy_channel);
+    RUN_TEST(test_dead_channel);
+    RUN_TEST(test_stepwise);
+    RUN_TEST(test_saved_result);
+    return UNITY_END();
+}
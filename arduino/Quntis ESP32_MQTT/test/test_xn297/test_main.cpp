@@ -0,0 +1,227 @@
+//
+//	test_main.cpp (test_xn297)
+//
+//	    The XN297 codec against the reference encoder in test/mock/Reference: the lookup tables
+//	    and the frames QuntisControl prepares in begin() must give the same bytes on air as the
+//	    bit by bit CRC and bit reversal encoding everything per frame did. XN297_Decode and
+//	    XN297_ReadPayload have to undo it.
+//
+//=================================================================================================
+#include <QuntisControl.h>
+#include <air.h>
+#include <unity.h>
+#include <xn297.h>
+#include <xn297_reference.h>
+
+#include <vector>
+
+static const byte address[ADDRESS_LENGTH] = {0x20, 0x21, 0x01, 0x31, 0xAA};
+
+void setUp() {
+    sim::Reset();
+}
+
+void tearDown() {
+}
+
+//=================================================================================================
+// Every address length, payload length and byte value encodes like the reference
+//=================================================================================================
+void test_lut_matches_bitwise() {
+    XN297 codec;
+    XN297_Frame frame;
+    uint8_t msg[20];
+    uint8_t expected[32];
+
+    for (uint8_t addrLen = 3; addrLen <= 5; addrLen++) {
+        codec.XN297_SetTXAddr(address, addrLen);
+        for (uint8_t len = 1; len <= sizeof(msg); len++) {
+            for (int value = 0; value < 256; value++) {
+                for (uint8_t i = 0; i < len; i++) {
+                    msg[i] = value + i * 37;
+                }
+                codec.XN297_PrepareFrame(frame, msg, len, len);
+                uint8_t frameLen = codec.XN297_FinishFrame(frame, msg);
+
+                uint8_t expectedLen = xn297_reference::Encode(address, addrLen, msg, len, expected);
+                TEST_ASSERT_EQUAL(expectedLen, frameLen);
+                TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, frame.buf, expectedLen);
+            }
+        }
+    }
+}
+
+// XN297_WritePayload puts the same bytes on air
+void test_write_payload_on_air() {
+    XN297 codec;
+    TEST_ASSERT_TRUE(codec.begin(CE_PIN, CSN_PIN));
+    codec.setPayloadSize(ADDRESS_LENGTH + PAYLOAD_LENGTH + 2);
+    codec.setAddressWidth(5);
+    codec.XN297_SetTXAddr(address, ADDRESS_LENGTH);
+
+    byte payload[PAYLOAD_LENGTH] = {0x00, 0x76, 0x9A, 0x31, 0x4A, QUNTIS_CMD_ONOFF};
+    uint8_t expected[32];
+    uint8_t expectedLen = xn297_reference::Encode(address, ADDRESS_LENGTH, payload, PAYLOAD_LENGTH, expected);
+    codec.XN297_WritePayload(payload, PAYLOAD_LENGTH);
+
+    TEST_ASSERT_EQUAL(1, sim::Air::GetLog().size());
+    TEST_ASSERT_EQUAL(expectedLen, sim::Air::GetLog()[0].len);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, sim::Air::GetLog()[0].data, expectedLen);
+}
+
+//=================================================================================================
+// QuntisControl only finishes the index/cmd tail of the frame it prepared in begin()
+//=================================================================================================
+void test_prepared_frames_on_air() {
+    QuntisControl controller;
+    TEST_ASSERT_TRUE(controller.begin());
+    controller.SetIndex(250);  // wraps around
+    controller.OnOff();
+    for (int i = 0; i < 5; i++) {
+        TEST_ASSERT_TRUE(sim::RunUntil([&]() { return controller.Dim(i % 2, true, 0, i < 4); }, 10000000ULL));
+        TEST_ASSERT_TRUE(sim::RunUntil([&]() { return controller.Color(i % 2, true, 0, i < 4); }, 10000000ULL));
+    }
+    TEST_ASSERT_TRUE(sim::RunUntil([&]() { return controller.IsTxIdle(); }, 10000000ULL));
+
+    byte payload[PAYLOAD_LENGTH];
+    memcpy(payload, controller.GetPayload(), PAYLOAD_LENGTH);
+    uint8_t expected[32];
+    uint8_t decodedAddr[ADDRESS_LENGTH];
+    uint8_t decoded[PAYLOAD_LENGTH];
+    TEST_ASSERT_GREATER_OR_EQUAL(11, sim::Air::GetLog().size());
+    for (const sim::AirFrame& frame : sim::Air::GetLog()) {
+        TEST_ASSERT_TRUE(XN297::XN297_Decode(frame.data, ADDRESS_LENGTH, decodedAddr, decoded, PAYLOAD_LENGTH));
+        payload[PL_INDEX] = decoded[PL_INDEX];
+        payload[PL_CMD] = decoded[PL_CMD];
+        uint8_t expectedLen = xn297_reference::Encode(address, ADDRESS_LENGTH, payload, PAYLOAD_LENGTH, expected);
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, frame.data, expectedLen);
+    }
+}
+
+//=================================================================================================
+// Decode: the round trip for 3/4/5 byte addresses, the capture in the README, broken frames
+//=================================================================================================
+void test_round_trip() {
+    XN297 codec;
+    XN297_Frame frame;
+    uint8_t msg[20];
+    uint8_t addr[5];
+    uint8_t decoded[sizeof(msg)];
+
+    for (uint8_t addrLen = 3; addrLen <= 5; addrLen++) {
+        codec.XN297_SetTXAddr(address, addrLen);
+        uint8_t offset = addrLen < 4 ? 1 : 0;  // the 0x55 preamble byte is not part of the frame
+        for (uint8_t len = 1; len <= sizeof(msg); len++) {
+            for (uint8_t i = 0; i < len; i++) {
+                msg[i] = len * 11 + i * 37;
+            }
+            codec.XN297_PrepareFrame(frame, msg, len, len);
+            codec.XN297_FinishFrame(frame, msg);
+
+            TEST_ASSERT_TRUE(XN297::XN297_Decode(frame.buf + offset, addrLen, addr, decoded, len));
+            TEST_ASSERT_EQUAL_HEX8_ARRAY(address, addr, addrLen);
+            TEST_ASSERT_EQUAL_HEX8_ARRAY(msg, decoded, len);
+        }
+    }
+}
+
+void test_decode_capture() {
+    const uint8_t raw[] = {0x49, 0x80, 0x4A, 0xCB, 0xA5, 0xBC, 0x8B, 0x3F, 0x81, 0xFC, 0x88, 0xCF, 0xE5};
+    const uint8_t data[PAYLOAD_LENGTH] = {0x00, 0x76, 0x9A, 0x31, 0x4A, 0x20};
+    uint8_t addr[ADDRESS_LENGTH];
+    uint8_t msg[PAYLOAD_LENGTH];
+
+    TEST_ASSERT_TRUE(XN297::XN297_Decode(raw, ADDRESS_LENGTH, addr, msg, PAYLOAD_LENGTH));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(address, addr, ADDRESS_LENGTH);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(data, msg, PAYLOAD_LENGTH);
+}
+
+// Every single bit error is caught by the CRC
+void test_decode_bit_errors() {
+    const uint8_t raw[] = {0x49, 0x80, 0x4A, 0xCB, 0xA5, 0xBC, 0x8B, 0x3F, 0x81, 0xFC, 0x88, 0xCF, 0xE5};
+    uint8_t broken[sizeof(raw)];
+    uint8_t addr[ADDRESS_LENGTH];
+    uint8_t msg[PAYLOAD_LENGTH];
+
+    for (size_t bit = 0; bit < sizeof(raw) * 8; bit++) {
+        memcpy(broken, raw, sizeof(raw));
+        broken[bit / 8] ^= 0x80 >> (bit % 8);
+        TEST_ASSERT_FALSE(XN297::XN297_Decode(broken, ADDRESS_LENGTH, addr, msg, PAYLOAD_LENGTH));
+    }
+    TEST_ASSERT_FALSE(XN297::XN297_Decode(raw, 2, addr, msg, PAYLOAD_LENGTH));
+}
+
+// Over the air: a receiver on our address takes the frame, one on another address drops it
+void test_read_payload() {
+    const byte other[ADDRESS_LENGTH] = {0x20, 0x21, 0x01, 0x31, 0xAB};
+    XN297 tx, rx, rxOther;
+    XN297* radios[] = {&tx, &rx, &rxOther};
+    for (XN297* radio : radios) {
+        TEST_ASSERT_TRUE(radio->begin(CE_PIN, CSN_PIN));
+        radio->setChannel(2);
+        radio->setPayloadSize(ADDRESS_LENGTH + PAYLOAD_LENGTH + 2);
+        radio->setAutoAck(false);
+        radio->disableCRC();
+    }
+    tx.XN297_SetTXAddr(address, ADDRESS_LENGTH);
+    rx.XN297_SetRXAddr(address, ADDRESS_LENGTH);
+    rxOther.XN297_SetRXAddr(other, ADDRESS_LENGTH);
+    rx.startListening();
+    rxOther.startListening();
+    sim::Advance(1000);
+
+    byte payload[PAYLOAD_LENGTH] = {0x00, 0x76, 0x9A, 0x31, 0x17, QUNTIS_CMD_COLOR};
+    tx.XN297_WritePayload(payload, PAYLOAD_LENGTH);
+    sim::Advance(1000);
+
+    uint8_t msg[PAYLOAD_LENGTH];
+    TEST_ASSERT_TRUE(rx.available());
+    TEST_ASSERT_EQUAL(1, rx.XN297_ReadPayload(msg, PAYLOAD_LENGTH));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(payload, msg, PAYLOAD_LENGTH);
+    TEST_ASSERT_TRUE(rxOther.available());
+    TEST_ASSERT_EQUAL(0, rxOther.XN297_ReadPayload(msg, PAYLOAD_LENGTH));
+}
+
+//=================================================================================================
+// Two codecs in one process keep their own address, length and CRC state
+//=================================================================================================
+void test_two_encoders() {
+    const byte second[4] = {0x11, 0x22, 0x33, 0x44};
+    XN297 first, other;
+    XN297* radios[] = {&first, &other};
+    for (XN297* radio : radios) {
+        TEST_ASSERT_TRUE(radio->begin(CE_PIN, CSN_PIN));
+        radio->setPayloadSize(ADDRESS_LENGTH + PAYLOAD_LENGTH + 2);
+    }
+    first.XN297_SetTXAddr(address, ADDRESS_LENGTH);
+    other.XN297_SetTXAddr(second, sizeof(second));
+
+    byte payload[PAYLOAD_LENGTH] = {0x00, 0x76, 0x9A, 0x31, 0x00, QUNTIS_CMD_DIM};
+    for (int i = 0; i < 4; i++) {
+        payload[PL_INDEX] = i;
+        (i % 2 ? other : first).XN297_WritePayload(payload, PAYLOAD_LENGTH);
+    }
+
+    uint8_t expected[32];
+    const std::vector<sim::AirFrame>& log = sim::Air::GetLog();
+    TEST_ASSERT_EQUAL(4, log.size());
+    for (int i = 0; i < 4; i++) {
+        payload[PL_INDEX] = i;
+        uint8_t len = i % 2 ? xn297_reference::Encode(second, sizeof(second), payload, PAYLOAD_LENGTH, expected)
+                            : xn297_reference::Encode(address, ADDRESS_LENGTH, payload, PAYLOAD_LENGTH, expected);
+        TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, log[i].data, len);
+    }
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_lut_matches_bitwise);
+    RUN_TEST(test_write_payload_on_air);
+    RUN_TEST(test_prepared_frames_on_air);
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_decode_capture);
+    RUN_TEST(test_decode_bit_errors);
+    RUN_TEST(test_read_payload);
+    RUN_TEST(test_two_encoders);
+    return UNITY_END();
+}
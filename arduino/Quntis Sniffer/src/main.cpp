@@ -19,6 +19,7 @@
 //  Raw:     49 80 4A CB A5 BC 8B 3F 81 FC 88 CF E5
 //  Address: 0x20 0x21 0x01 0x31 0xAA
 //  Data:    0x00 0x76 0x9A 0x31 0x4A 0x20
+//  CRC:     OK
 //
 // The address is unique per remote and is what need to copy over to QuntisControl.h
 // to be able to control your LED bar.
@@ -26,65 +27,25 @@
 #include <Arduino.h>
 #include <RF24.h>
 #include <SPI.h>
+#include <xn297.h>
 
 #define CE_PIN 17
 #define CSN_PIN 5
 
 RF24 radio(CE_PIN, CSN_PIN);
 
-// XN297 scramble table (from XN297 protocol reverse engineering)
-static const uint8_t xn297_scramble[] = {
-    0xe3, 0xb1, 0x4b, 0xea, 0x85, 0xbc, 0xe5, 0x66,
-    0x0d, 0xae, 0x8c, 0x88, 0x12, 0x69, 0xee, 0x1f,
-    0xc7, 0x62, 0x97, 0xd5, 0x0b, 0x79, 0xca, 0xcc,
-    0x1b, 0x5d, 0x19, 0x10, 0x24, 0xd3, 0xdc, 0x3f};
-
-// XN297 CRC table
-static const uint16_t xn297_crc_xorout[] = {
-    0x0000, 0x3d5f, 0xa6f1, 0x3a23, 0xaa16, 0x1caf,
-    0x62b2, 0xe0eb, 0x0821, 0xbe07, 0x5f1a, 0xaf15,
-    0x4f01, 0xad16, 0x5f31, 0x7a56, 0x1b71, 0x0a33,
-    0x7e44, 0xae90};
-
-static uint16_t crc16_update(uint16_t crc, uint8_t byte, uint8_t bits) {
-    crc ^= (uint16_t)byte << 8;
-    for (uint8_t i = 0; i < bits; i++) {
-        if (crc & 0x8000)
-            crc = (crc << 1) ^ 0x1021;
-        else
-            crc <<= 1;
-    }
-    return crc;
-}
-
-static uint8_t bit_reverse(uint8_t b) {
-    b = ((b & 0xF0) >> 4) | ((b & 0x0F) << 4);
-    b = ((b & 0xCC) >> 2) | ((b & 0x33) << 2);
-    b = ((b & 0xAA) >> 1) | ((b & 0x55) << 1);
-    return b;
-}
-
 // Descramble and decode a captured XN297 packet
 // Input: raw[] = 13 bytes captured after the 3-byte NRF24 address match
 //        (5 scrambled addr bytes + 6 scrambled data bytes + 2 CRC bytes)
-// Output: prints decoded address and payload
-void decodePacket(const uint8_t* raw, int len) {
-    if (len < 13) return;
+// Output: prints decoded address and payload, returns true when the XN297 CRC matches
+bool decodePacket(const uint8_t* raw, int len) {
+    if (len < 13) return false;
 
-    // Descramble the 5 address bytes
-    // XN297 address is scrambled with XOR and sent MSByte first (reversed from NRF24 perspective)
+    // Descramble the address (sent MSByte first) and the bit-reversed data, and check the
+    // XN297 CRC over both as they are on air
     uint8_t addr[5];
-    for (int i = 0; i < 5; i++) {
-        addr[4 - i] = raw[i] ^ xn297_scramble[i];
-    }
-
-    // Descramble the 6 data bytes
-    // XN297 data is scrambled AND bit-reversed
     uint8_t data[6];
-    for (int i = 0; i < 6; i++) {
-        uint8_t b = raw[5 + i] ^ xn297_scramble[5 + i];
-        data[i] = bit_reverse(b);
-    }
+    bool crcValid = XN297::XN297_Decode(raw, 5, addr, data, 6);
 
     Serial.println("────────────────────────────────────");
     Serial.print("  Raw:     ");
@@ -104,6 +65,9 @@ void decodePacket(const uint8_t* raw, int len) {
         Serial.printf("0x%02X ", data[i]);
     }
     Serial.println();
+
+    Serial.printf("  CRC:     %s\n", crcValid ? "OK" : "MISMATCH");
+    return crcValid;
 }
 
 void setup() {
@@ -218,7 +182,9 @@ void loop() {
                 confirmedPackets++;
                 Serial.printf("\nDuplicate packet detected (%lums apart)!\n", now - lastTime);
 
-                decodePacket(buf, 13);
+                if (decodePacket(buf, 13)) {
+                    crcValidPackets++;
+                }
 
                 // Skip remaining duplicates from printing
                 haveLast = false;
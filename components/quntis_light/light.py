@@ -17,12 +17,19 @@ CONF_COLOR_TEMP_STEPS = "color_temp_steps"
 CONF_MIN_MIREDS = "min_mireds"
 CONF_MAX_MIREDS = "max_mireds"
 CONF_STEP_DELAY = "step_delay"
+CONF_REPEAT_GAP = "repeat_gap"
+CONF_REPEAT_COUNT = "repeat_count"
+CONF_FRAME_LOSS = "frame_loss"
+CONF_CARRIER_SENSE = "carrier_sense"
+CONF_LISTEN_REMOTE = "listen_remote"
+CONF_HOLD_RATE = "hold_rate"
 
 CONFIG_SCHEMA = (
     light.LIGHT_SCHEMA.extend(
         {
             # esphome
             cv.GenerateID(CONF_OUTPUT_ID): cv.declare_id(QuntisLight),
+            # Transitions pace the RF steps over their length, without one a change goes out at step_delay speed
             cv.Optional(CONF_DEFAULT_TRANSITION_LENGTH, default="0s"): cv.positive_time_period_milliseconds,
             cv.Optional(CONF_GAMMA_CORRECT, default=1.0): cv.positive_float,
             
@@ -39,6 +46,12 @@ CONFIG_SCHEMA = (
             cv.Optional(CONF_MIN_MIREDS, default=153): cv.int_range(min=1, max=1000),
             cv.Optional(CONF_MAX_MIREDS, default=500): cv.int_range(min=1, max=1000),
             cv.Optional(CONF_STEP_DELAY, default="50ms"): cv.positive_time_period_milliseconds,
+            cv.Optional(CONF_REPEAT_GAP, default="5ms"): cv.positive_time_period_microseconds,
+            cv.Optional(CONF_REPEAT_COUNT, default=6): cv.int_range(min=1, max=20),
+            cv.Optional(CONF_FRAME_LOSS, default=0.5): cv.float_range(min=0.0, max=1.0),
+            cv.Optional(CONF_CARRIER_SENSE, default=True): cv.boolean,
+            cv.Optional(CONF_LISTEN_REMOTE, default=True): cv.boolean,
+            cv.Optional(CONF_HOLD_RATE, default=0.0): cv.positive_float,
             cv.Optional(CONF_DEVICE_PAYLOAD, default=[0x00, 0x76, 0x9A, 0x31]): cv.All(
                 cv.ensure_list(cv.hex_uint8_t), 
                 cv.Length(min=4, max=4)
@@ -82,3 +95,9 @@ async def to_code(config):
     cg.add(var.set_min_mireds(config[CONF_MIN_MIREDS]))
     cg.add(var.set_max_mireds(config[CONF_MAX_MIREDS]))
     cg.add(var.set_step_delay(config[CONF_STEP_DELAY].total_milliseconds))
+    cg.add(var.set_repeat_gap(config[CONF_REPEAT_GAP].total_microseconds))
+    cg.add(var.set_repeat_count(config[CONF_REPEAT_COUNT]))
+    cg.add(var.set_frame_loss(config[CONF_FRAME_LOSS]))
+    cg.add(var.set_carrier_sense(config[CONF_CARRIER_SENSE]))
+    cg.add(var.set_listen_remote(config[CONF_LISTEN_REMOTE]))
+    cg.add(var.set_hold_rate(config[CONF_HOLD_RATE]))
@@ -8,6 +8,7 @@
 //
 #include "quntis_control.h"
 
+#include "esphome/core/helpers.h"
 #include "esphome/core/log.h"
 
 static const char* const TAG = "quntis";
@@ -31,8 +32,52 @@ void QuntisControl::set_device_payload(const std::vector<uint8_t>& payload) {
     }
 }
 
+void QuntisControl::set_repeat_gap(uint32_t gap_us) {
+    _repeat_gap_us = gap_us;
+}
+
+int QuntisControl::add_lamp(const std::vector<uint8_t>& addr, const std::vector<uint8_t>& payload) {
+    if (_lamp_count == 0) {
+        _lamp_count = 1;  // slot 0 stays reserved for set_device_address/set_device_payload
+    }
+    if (_lamp_count >= MAX_LAMPS) {
+        ESP_LOGE(TAG, "Cannot add lamp, MAX_LAMPS=%d reached", MAX_LAMPS);
+        return -1;
+    }
+
+    Lamp& lamp = _lamps[_lamp_count];
+    memset(lamp.address, 0, sizeof(lamp.address));
+    memset(lamp.payload, 0, sizeof(lamp.payload));
+    for (size_t i = 0; i < ADDRESS_LENGTH && i < addr.size(); i++) {
+        lamp.address[i] = addr[i];
+    }
+    for (size_t i = 0; i < PL_INDEX && i < payload.size(); i++) {
+        lamp.payload[i] = payload[i];
+    }
+    if (_radio) {
+        reset_lamp_(lamp);
+    }
+    return _lamp_count++;
+}
+
+void QuntisControl::reset_lamp_(Lamp& lamp) {
+    lamp.index = 0;
+    lamp.head = lamp.tail = 0;
+    lamp.left = 0;
+    _radio->XN297_PrepareFrame(lamp.frame, lamp.address, lamp.payload, PL_INDEX, PAYLOAD_LENGTH);
+}
+
 bool QuntisControl::begin() {
-    _index = 0;
+    if (!_tx_timer) {
+        esp_timer_create_args_t args = {};
+        args.callback = &QuntisControl::tx_timer_callback_;
+        args.arg = this;
+        args.name = "quntis_tx";
+        if (esp_timer_create(&args, &_tx_timer) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to create TX timer");
+            return false;
+        }
+    }
 
     if (_radio) {
         delete _radio;
@@ -57,8 +102,19 @@ bool QuntisControl::begin() {
     _radio->setRetries(0, 0);
 
     _radio->XN297_SetTXAddr(_address, ADDRESS_LENGTH);
+    _radio->XN297_SetRXAddr(_address, ADDRESS_LENGTH);  // for poll_rx(), frames are matched by QuntisLamp
+
+    // Lamp 0 is the configured device address/payload, lamps from add_lamp() keep their slot
+    memcpy(_lamps[0].address, _address, ADDRESS_LENGTH);
+    memcpy(_lamps[0].payload, _payload, PAYLOAD_LENGTH);
+    if (_lamp_count == 0) {
+        _lamp_count = 1;
+    }
+    for (uint8_t i = 0; i < _lamp_count; i++) {
+        reset_lamp_(_lamps[i]);
+    }
 
-    ESP_LOGI(TAG, "RF24 initialized: CE=%d CSN=%d", _ce_pin, _csn_pin);
+    ESP_LOGI(TAG, "RF24 initialized: CE=%d CSN=%d, repeat gap %uus", _ce_pin, _csn_pin, (unsigned)_repeat_gap_us);
     ESP_LOGI(TAG, "Device address: %02X %02X %02X %02X %02X",
              _address[0], _address[1], _address[2], _address[3], _address[4]);
     ESP_LOGI(TAG, "Device payload prefix: %02X %02X %02X %02X",
@@ -67,41 +123,296 @@ bool QuntisControl::begin() {
     return true;
 }
 
-void QuntisControl::OnOff() {
-    SendCommand(QUNTIS_CMD_ONOFF, true);
+bool QuntisControl::OnOff(uint8_t lamp) {
+    return SendCommand(lamp, QUNTIS_CMD_ONOFF, _repeat_count, _repeat_gap_us);
 }
 
-void QuntisControl::Dim(bool up, bool repeat) {
-    SendCommand(QUNTIS_CMD_DIM | (uint8_t)(up ? QUNTIS_CMD_UP : QUNTIS_CMD_DOWN), repeat);
+bool QuntisControl::Dim(bool up, bool repeat, uint8_t lamp, bool intermediate) {
+    return send_step_(lamp, QUNTIS_CMD_DIM | (uint8_t)(up ? QUNTIS_CMD_UP : QUNTIS_CMD_DOWN), repeat, intermediate);
 }
 
-void QuntisControl::Color(bool up, bool repeat) {
-    SendCommand(QUNTIS_CMD_COLOR | (uint8_t)(up ? QUNTIS_CMD_UP : QUNTIS_CMD_DOWN), repeat);
+bool QuntisControl::Color(bool up, bool repeat, uint8_t lamp, bool intermediate) {
+    return send_step_(lamp, QUNTIS_CMD_COLOR | (uint8_t)(up ? QUNTIS_CMD_UP : QUNTIS_CMD_DOWN), repeat, intermediate);
 }
 
-void QuntisControl::SendCommand(uint8_t cmd, bool repeat) {
-    _payload[PL_CMD] = cmd;
-    _payload[PL_INDEX] = _index++;
+// Copies an intermediate step needs so it is lost with less than TX_STEP_MISS chance
+uint8_t QuntisControl::get_step_repeat() const {
+    uint8_t count = 1;
+    float miss = _frame_loss;
+    while (count < _repeat_count && miss > TX_STEP_MISS) {
+        miss *= _frame_loss;
+        count++;
+    }
+    return count;
+}
+
+// The repeat gaps, the listen before the first copy, the last copy on air and the tick that sees it drained
+uint32_t QuntisControl::get_burst_us(uint16_t count) const {
+    return (count - 1) * _repeat_gap_us + (_carrier_sense ? TX_SENSE_US : 0) + TX_FRAME_US + TX_FIFO_POLL_US;
+}
 
-    ESP_LOGD(TAG, "SendCommand cmd=0x%02X idx=%d repeat=%s", cmd, _payload[PL_INDEX], repeat ? "true" : "false");
+// The copies an intermediate step leaves out count as saved once the step is queued
+bool QuntisControl::send_step_(uint8_t lamp, uint8_t cmd, bool repeat, bool intermediate) {
+    uint16_t count = !repeat ? 1 : intermediate ? get_step_repeat() : _repeat_count;
+    if (!SendCommand(lamp, cmd, count, _repeat_gap_us)) {
+        return false;
+    }
+    if (repeat && intermediate) {
+        _frames_saved += _repeat_count - count;
+        _burst_us_saved += (uint64_t)(_repeat_count - count) * _repeat_gap_us;
+    }
+    return true;
+}
+
+// Moving average of the loss seen by a monitor receiver, small samples are too noisy
+void QuntisControl::report_frames(uint32_t sent, uint32_t heard) {
+    if (sent < 20) {
+        return;
+    }
+    float loss = heard >= sent ? 0.0f : 1.0f - (float)heard / sent;
+    _frame_loss = 0.8f * _frame_loss + 0.2f * loss;
+}
+
+bool QuntisControl::ramp(uint8_t axis, bool up, uint32_t duration_ms, uint8_t lamp) {
+    uint32_t frames = duration_ms * 1000 / _hold_gap_us + 1;
+    return SendCommand(lamp, axis | (uint8_t)(up ? QUNTIS_CMD_UP : QUNTIS_CMD_DOWN), frames > UINT16_MAX ? UINT16_MAX : frames,
+                       _hold_gap_us);
+}
+
+// Queue the command and return, tx_tick_() sends it once the lamp's earlier bursts are done. A full
+// queue turns the command away instead of waiting for the radio.
+bool QuntisControl::SendCommand(uint8_t id, uint8_t cmd, uint16_t count, uint32_t gap) {
+    if (id >= _lamp_count) {
+        ESP_LOGW(TAG, "SendCommand: unknown lamp %d", id);
+        return false;
+    }
+
+    Lamp& lamp = _lamps[id];
+    if ((uint8_t)(lamp.head - lamp.tail) >= TX_QUEUE_SIZE) {
+        ESP_LOGW(TAG, "SendCommand lamp=%d cmd=0x%02X: queue full, dropped", id, cmd);
+        return false;
+    }
+    TxCommand tx = {cmd, lamp.index++, count, gap};
+
+    ESP_LOGD(TAG, "SendCommand lamp=%d cmd=0x%02X idx=%d frames=%d queued=%d", id, cmd, tx.index, count,
+             (uint8_t)(lamp.head - lamp.tail));
+
+    portENTER_CRITICAL(&_tx_mux);
+    lamp.queue[lamp.head % TX_QUEUE_SIZE] = tx;
+    lamp.head++;
+    bool start = !_tx_running;
+    _tx_running = true;
+    portEXIT_CRITICAL(&_tx_mux);
+
+    if (start) {
+        esp_timer_start_once(_tx_timer, 1);
+    }
+    return true;
+}
+
+void QuntisControl::tx_timer_callback_(void* arg) {
+    static_cast<QuntisControl*>(arg)->tx_tick_();
+}
+
+// Runs in the esp_timer task. Every lamp with a queued command gets a burst, and due frames go
+// into the TX FIFO earliest deadline first, so one lamp's repeat gap carries the frames of the
+// others. Re-arms itself for the next frame that is due.
+void QuntisControl::tx_tick_() {
+    if (_rx_active) {
+        stop_rx_();
+    }
+    uint32_t now = micros();
 
-    if (repeat) {
-        for (int i = 0; i < TX_REPEAT; i++) {
-            bool ok = _radio->XN297_WritePayload(_payload, PAYLOAD_LENGTH);
-            if (i == 0) {
-                ESP_LOGD(TAG, "XN297_WritePayload: %s", ok ? "OK" : "FAIL");
+    for (uint8_t i = 0; i < _lamp_count; i++) {
+        Lamp& lamp = _lamps[i];
+        if (lamp.left == 0 && lamp.tail != lamp.head) {
+            lamp.current = lamp.queue[lamp.tail % TX_QUEUE_SIZE];
+            lamp.tail++;
+
+            // Encode once, every repeat is the same buffer
+            lamp.payload[PL_CMD] = lamp.current.cmd;
+            lamp.payload[PL_INDEX] = lamp.current.index;
+            lamp.frame_len = _radio->XN297_FinishFrame(lamp.frame, lamp.payload);
+            lamp.left = lamp.current.count;
+            lamp.next = now;
+            lamp.last_frame_us = 0;
+            lamp.queued_us = now;
+            lamp.deferrals = 0;
+        }
+    }
+
+    while (true) {
+        // While the radio listens before a burst nothing else goes out
+        Lamp* due = nullptr;
+        if (_sensing) {
+            due = (int32_t)(now - _sensing->next) >= 0 ? _sensing : nullptr;
+        }
+        for (uint8_t i = 0; i < _lamp_count && !_sensing; i++) {
+            Lamp& lamp = _lamps[i];
+            if (lamp.left > 0 && (int32_t)(now - lamp.next) >= 0 && (!due || (int32_t)(lamp.next - due->next) < 0)) {
+                due = &lamp;
+            }
+        }
+        if (!due) {
+            break;
+        }
+        if (due->left == due->current.count && tx_hold_burst_(*due, now)) {
+            continue;
+        }
+        if (!_radio->XN297_QueueFrame(due->frame.buf, due->frame_len)) {
+            break;
+        }
+        tx_record_frame_(*due, now);
+        due->next += due->current.gap;
+        if (--due->left == 0 && _tx_done) {
+            _tx_done(due - _lamps, due->current.cmd);
+        }
+    }
+
+    // Next tick: the earliest frame still to send, a lamp with more queued, or the FIFO draining
+    bool pending = false;
+    int32_t wait = INT32_MAX;
+    now = micros();
+    for (uint8_t i = 0; i < _lamp_count; i++) {
+        Lamp& lamp = _lamps[i];
+        if (lamp.left > 0) {
+            pending = true;
+            if ((int32_t)(lamp.next - now) < wait) {
+                wait = (int32_t)(lamp.next - now);
             }
-            if (i < TX_REPEAT - 1) {
-                delayMicroseconds(TX_REPEAT_DELAY * 1000);
-                yield();  // Let WiFi/system tasks run
+        } else if (lamp.tail != lamp.head) {
+            pending = true;
+            wait = 0;
+        }
+    }
+    if (_sensing) {
+        wait = (int32_t)(_sensing->next - now);
+    }
+
+    if (!pending) {
+        if (!_radio->XN297_TxDrained()) {
+            esp_timer_start_once(_tx_timer, TX_FIFO_POLL_US);
+            return;
+        }
+
+        // Stop unless SendCommand() queued something meanwhile
+        portENTER_CRITICAL(&_tx_mux);
+        for (uint8_t i = 0; i < _lamp_count && !pending; i++) {
+            pending = _lamps[i].tail != _lamps[i].head;
+        }
+        _tx_running = pending;
+        portEXIT_CRITICAL(&_tx_mux);
+
+        if (!pending) {
+            if (_rx_frame) {
+                start_rx_();
             }
+            return;
+        }
+        wait = 0;
+    }
+
+    esp_timer_start_once(_tx_timer, wait > 0 ? wait : TX_FIFO_POLL_US);
+}
+
+// Before the first frame of a burst: listen on the channel. Returns true and moves lamp.next when
+// the burst has to wait, false to send now. The listen spans two ticks, the timer comes back for
+// the RPD bit instead of waiting here.
+bool QuntisControl::tx_hold_burst_(Lamp& lamp, uint32_t now) {
+    if (_sensing != &lamp) {
+        // Our own frames still in the FIFO would trip RPD, the channel is ours then anyway
+        if (_carrier_sense && _radio->XN297_TxDrained()) {
+            _carrier_stats.senses++;
+            _radio->XN297_StartSense();
+            _sensing = &lamp;
+            lamp.next = now + TX_SENSE_US;
+            return true;
         }
     } else {
-        bool ok = _radio->XN297_WritePayload(_payload, PAYLOAD_LENGTH);
-        ESP_LOGD(TAG, "XN297_WritePayload: %s", ok ? "OK" : "FAIL");
+        _sensing = nullptr;
+        if (_radio->XN297_EndSense()) {
+            _carrier_stats.busy++;
+            if (lamp.deferrals < TX_MAX_DEFER) {
+                if (lamp.deferrals++ == 0) {
+                    _carrier_stats.deferred++;
+                }
+                // Random part so two senders that backed off together do not retry together
+                uint32_t backoff = TX_BACKOFF_US << (lamp.deferrals - 1);
+                lamp.next = micros() + backoff + esphome::random_uint32() % backoff;
+                return true;
+            }
+            _carrier_stats.forced++;
+        }
+    }
+
+    _carrier_stats.bursts++;
+    _carrier_stats.wait_us += (uint32_t)(micros() - lamp.queued_us);
+    return false;
+}
+
+void QuntisControl::set_rx_callback(std::function<void(const uint8_t*, uint8_t)>&& callback) {
+    _rx_frame = std::move(callback);
+    if (_rx_frame && _radio && !_tx_running && !_rx_active) {
+        start_rx_();
+    }
+}
+
+// Runs in the loop task, which is also the only one that starts the TX timer, so the radio is
+// ours whenever RX is active and no burst is queued
+void QuntisControl::poll_rx() {
+    uint8_t raw[ADDRESS_LENGTH + PAYLOAD_LENGTH + 2];
+
+    while (_rx_active && !_tx_running && _radio->available()) {
+        _radio->read(raw, sizeof(raw));
+        _rx_frames++;
+        if (_rx_frame) {
+            _rx_frame(raw, sizeof(raw));
+        }
+    }
+}
+
+void QuntisControl::start_rx_() {
+    _radio->startListening();
+    _rx_active = true;
+}
+
+void QuntisControl::stop_rx_() {
+    _rx_active = false;
+    _radio->stopListening();
+}
+
+// Histogram of how far the spacing between two frames of a burst is off its gap
+void QuntisControl::tx_record_frame_(Lamp& lamp, uint32_t now) {
+    static const uint32_t limits[TX_JITTER_BUCKETS - 1] = {50, 100, 250, 500, 1000, 2500, 5000};
+
+    if (lamp.last_frame_us != 0) {
+        int32_t deviation = (int32_t)(now - lamp.last_frame_us - lamp.current.gap);
+        uint32_t jitter = deviation < 0 ? -deviation : deviation;
+        uint8_t bucket = 0;
+        while (bucket < TX_JITTER_BUCKETS - 1 && jitter >= limits[bucket]) {
+            bucket++;
+        }
+        _jitter_hist[bucket]++;
     }
+    lamp.last_frame_us = now;
 }
 
 long QuntisControl::GetPacketCount() {
     return _radio ? _radio->GetPacketCount() : 0;
 }
+
+std::string QuntisControl::get_rf_info() const {
+    const CarrierStats& cs = _carrier_stats;
+    char buf[288];
+    snprintf(buf, sizeof(buf),
+             "packets=%ld gap=%uus saved=%u frames/%ums loss=%.0f%% "
+             "carrier sense %s: bursts=%u busy=%u/%u deferred=%u forced=%u delay=%uus "
+             "jitter[<50us <100 <250 <500 <1ms <2.5ms <5ms >=5ms]=%u %u %u %u %u %u %u %u",
+             _radio ? _radio->GetPacketCount() : 0L, (unsigned)_repeat_gap_us, (unsigned)_frames_saved,
+             (unsigned)get_burst_time_saved_ms(), _frame_loss * 100, _carrier_sense ? "on" : "off",
+             (unsigned)cs.bursts, (unsigned)cs.busy, (unsigned)cs.senses, (unsigned)cs.deferred, (unsigned)cs.forced,
+             (unsigned)(cs.bursts ? cs.wait_us / cs.bursts : 0),
+             (unsigned)_jitter_hist[0], (unsigned)_jitter_hist[1], (unsigned)_jitter_hist[2], (unsigned)_jitter_hist[3],
+             (unsigned)_jitter_hist[4], (unsigned)_jitter_hist[5], (unsigned)_jitter_hist[6], (unsigned)_jitter_hist[7]);
+    return buf;
+}
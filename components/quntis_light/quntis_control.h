@@ -10,14 +10,30 @@
 //
 
 #include "xn297.h"
+#include <esp_timer.h>
+#include <algorithm>
+#include <functional>
 #include <string>
 #include <vector>
 
-#define TX_REPEAT 6
-#define TX_REPEAT_DELAY 5
+#define TX_REPEAT 6            // default frames per burst, see set_repeat_count()
+#define TX_REPEAT_GAP_US 5000  // default gap between repeats, see set_repeat_gap()
+#define TX_HOLD_GAP_US 5000    // frame spacing of a held button until the remote's is heard, see set_hold_gap()
+#define TX_LOSS_DEFAULT 0.5f   // frame loss assumed until set, high enough to keep full bursts
+#define TX_STEP_MISS 0.001f    // accepted chance to lose an intermediate step of a ramp
 #define PAYLOAD_LENGTH 6
 #define ADDRESS_LENGTH 5
 
+#define MAX_LAMPS 4            // lamps sharing the radio, each with its own address/payload/index
+#define TX_QUEUE_SIZE 8        // commands waiting for the radio, per lamp
+#define TX_FIFO_POLL_US 150    // timer tick while the TX FIFO is full or drains at the end
+#define TX_FRAME_US 200        // one frame on air at 1 Mbps, preamble to CRC, rounded up
+#define TX_JITTER_BUCKETS 8    // frame gap deviation: <50us <100 <250 <500 <1ms <2.5ms <5ms >=5ms
+
+#define TX_SENSE_US 200        // listen time before a burst, see set_carrier_sense()
+#define TX_BACKOFF_US 1000     // first backoff on a busy channel, doubles with every retry
+#define TX_MAX_DEFER 4         // busy retries before a burst goes out anyway
+
 // Payload indices
 #define PL_INDEX 4
 #define PL_CMD 5
@@ -37,28 +53,161 @@ class QuntisControl {
   void set_pins(uint8_t ce_pin, uint8_t csn_pin);
   void set_device_address(const std::vector<uint8_t> &addr);
   void set_device_payload(const std::vector<uint8_t> &payload);
+  void set_repeat_gap(uint32_t gap_us);
+  uint32_t get_repeat_gap() const { return _repeat_gap_us; }
+  void set_repeat_count(uint8_t count) { _repeat_count = count ? count : 1; }
+  uint8_t get_repeat_count() const { return _repeat_count; }
+
+  // Frame loss estimate, set from config or fed from a monitor receiver (frames heard of frames sent)
+  void set_loss_estimate(float loss) { _frame_loss = std::min(std::max(loss, 0.0f), 1.0f); }
+  float get_loss_estimate() const { return _frame_loss; }
+  void report_frames(uint32_t sent, uint32_t heard);
+  uint8_t get_step_repeat() const;
+  // Time a burst of count copies keeps the radio busy, from its first tick until the FIFO drained
+  uint32_t get_burst_us(uint16_t count) const;
+  uint32_t get_frames_saved() const { return _frames_saved; }
+  uint32_t get_burst_time_saved_ms() const { return _burst_us_saved / 1000; }
+
+  // Frame spacing of a ramp(). Starts at the gap the remote leaves between the frames of a press
+  // burst, QuntisLight sets it to the spacing of a held button once it hears one (listen_remote).
+  void set_hold_gap(uint32_t gap_us) { _hold_gap_us = gap_us ? gap_us : 1; }
+  uint32_t get_hold_gap() const { return _hold_gap_us; }
+
+  // Steps per second a hold achieves (0 = unknown, planners stick to single steps)
+  void set_hold_rate(float steps_per_sec) { _hold_rate = steps_per_sec; }
+  float get_hold_rate() const { return _hold_rate; }
 
   bool begin();
 
-  void OnOff();
-  void Dim(bool up, bool repeat = true);
-  void Color(bool up, bool repeat = true);
+  // Lamp 0 is set_device_address/set_device_payload, more lamps can be added and share the radio.
+  // Returns the lamp id to pass to OnOff/Dim/Color, -1 when MAX_LAMPS is reached.
+  int add_lamp(const std::vector<uint8_t> &addr, const std::vector<uint8_t> &payload);
+  uint8_t get_lamp_count() const { return _lamp_count; }
+
+  // intermediate: a step that a later one in the same direction follows, it gets only as many
+  // copies as the loss estimate needs. OnOff and final steps always get the full repeat count.
+  // All of them return false without queueing when the lamp already has TX_QUEUE_SIZE commands
+  // waiting, the caller tries again once the radio caught up (see is_tx_idle()).
+  bool OnOff(uint8_t lamp = 0);
+  bool Dim(bool up, bool repeat = true, uint8_t lamp = 0, bool intermediate = false);
+  bool Color(bool up, bool repeat = true, uint8_t lamp = 0, bool intermediate = false);
+
+  // Press-and-hold like the original remote: one command index streamed for the duration,
+  // the lamp keeps stepping while it hears it. axis is QUNTIS_CMD_DIM or QUNTIS_CMD_COLOR.
+  bool ramp(uint8_t axis, bool up, uint32_t duration_ms, uint8_t lamp = 0);
+
+  // Commands are queued and return at once, the bursts go out on esp_timer ticks.
+  // Bursts of different lamps are interleaved, so N lamps take about as long as one.
+  // The done callback runs in the esp_timer task, keep it short.
+  void set_tx_done_callback(std::function<void(uint8_t lamp, uint8_t cmd)> &&callback) { _tx_done = std::move(callback); }
+  bool is_tx_idle() const { return !_tx_running; }
+
+  // Carrier sense: listen before each burst and back off while the channel is busy (WiFi on
+  // the same band), a burst is deferred at most TX_MAX_DEFER times.
+  void set_carrier_sense(bool enabled) { _carrier_sense = enabled; }
+  bool get_carrier_sense() const { return _carrier_sense; }
+
+  struct CarrierStats {
+    uint32_t bursts;    // bursts started
+    uint32_t senses;    // channel checks
+    uint32_t busy;      // checks that found the channel busy
+    uint32_t deferred;  // bursts that backed off at least once
+    uint32_t forced;    // bursts sent on a busy channel after TX_MAX_DEFER retries
+    uint64_t wait_us;   // total start delay from backoffs
+  };
+  const CarrierStats &get_carrier_stats() const { return _carrier_stats; }
+
+  // Listen for the original remote while no burst is on air. poll_rx() hands every frame in the
+  // RX FIFO to the callback (raw, see QuntisLamp::accept), call it from loop(). Frames sent
+  // while we transmit are missed.
+  void set_rx_callback(std::function<void(const uint8_t *raw, uint8_t len)> &&callback);
+  void poll_rx();
+  uint32_t get_rx_frame_count() const { return _rx_frames; }
 
   long GetPacketCount();
+  const uint32_t *get_jitter_histogram() const { return _jitter_hist; }
 
   const uint8_t* get_address() const { return _address; }
   const uint8_t* get_payload() const { return _payload; }
+
+  // Index the next command goes out with. After a reset it has to move past the last one the
+  // lamp saw, or the lamp drops the first command as a repeat.
+  uint8_t get_index(uint8_t lamp = 0) const { return lamp < _lamp_count ? _lamps[lamp].index : 0; }
+  void set_index(uint8_t index, uint8_t lamp = 0) {
+    if (lamp < _lamp_count) _lamps[lamp].index = index;
+  }
   std::string get_rf_info() const;
 
  private:
-  void SendCommand(uint8_t cmd, bool repeat);
+  struct TxCommand {
+    uint8_t cmd;
+    uint8_t index;
+    uint16_t count;
+    uint32_t gap;
+  };
+
+  struct Lamp {
+    uint8_t address[ADDRESS_LENGTH];
+    uint8_t payload[PAYLOAD_LENGTH];
+    uint8_t index;
+
+    // Address and fixed payload part encoded once, each command only adds idx/cmd
+    XN297_Frame frame;
+    uint8_t frame_len;
+
+    // SendCommand() adds at head and the timer takes from tail
+    TxCommand queue[TX_QUEUE_SIZE];
+    volatile uint8_t head;
+    volatile uint8_t tail;
+
+    // Burst on air, only touched from the timer
+    TxCommand current;
+    uint16_t left;
+    uint32_t next;
+    uint32_t last_frame_us;
+    uint32_t queued_us;  // when the burst was taken from the queue
+    uint8_t deferrals;
+  };
+
+  bool SendCommand(uint8_t lamp, uint8_t cmd, uint16_t count, uint32_t gap);
+  bool send_step_(uint8_t lamp, uint8_t cmd, bool repeat, bool intermediate);
+  void reset_lamp_(Lamp &lamp);
+
+  static void tx_timer_callback_(void *arg);
+  void tx_tick_();
+  void tx_record_frame_(Lamp &lamp, uint32_t now);
+  bool tx_hold_burst_(Lamp &lamp, uint32_t now);
+  void start_rx_();
+  void stop_rx_();
 
   XN297 *_radio{nullptr};
   uint8_t _ce_pin{1};
   uint8_t _csn_pin{5};
+  uint32_t _repeat_gap_us{TX_REPEAT_GAP_US};
+  uint8_t _repeat_count{TX_REPEAT};
+  float _frame_loss{TX_LOSS_DEFAULT};
+  uint32_t _frames_saved{0};
+  uint64_t _burst_us_saved{0};
+  uint32_t _hold_gap_us{TX_HOLD_GAP_US};
+  float _hold_rate{0};
 
   uint8_t _address[ADDRESS_LENGTH] = {0};
   uint8_t _payload[PAYLOAD_LENGTH] = {0};
 
-  uint8_t _index{0};
+  Lamp _lamps[MAX_LAMPS];
+  uint8_t _lamp_count{0};
+
+  volatile bool _tx_running{false};
+  portMUX_TYPE _tx_mux = portMUX_INITIALIZER_UNLOCKED;
+  esp_timer_handle_t _tx_timer{nullptr};
+  std::function<void(uint8_t lamp, uint8_t cmd)> _tx_done;
+  uint32_t _jitter_hist[TX_JITTER_BUCKETS] = {0};
+
+  bool _carrier_sense{false};
+  Lamp *_sensing{nullptr};  // the lamp whose burst the radio listens before, see tx_hold_burst_()
+  CarrierStats _carrier_stats = {};
+
+  std::function<void(const uint8_t *raw, uint8_t len)> _rx_frame;
+  volatile bool _rx_active{false};
+  uint32_t _rx_frames{0};
 };
@@ -0,0 +1,102 @@
+//
+//  QuntisLamp - model of the receiving side of a Quntis ScreenLinear lamp
+//
+#include "quntis_lamp.h"
+
+#include <algorithm>
+#include <cstring>
+
+QuntisLamp::QuntisLamp(const uint8_t* address, const uint8_t* payload, int brightness_steps, int color_steps)
+    : _brightness_steps(brightness_steps), _color_steps(color_steps) {
+    memcpy(_address, address, ADDRESS_LENGTH);
+    memcpy(_payload, payload, PL_INDEX);
+}
+
+bool QuntisLamp::accept(const uint8_t* raw, uint8_t len) {
+    uint8_t addr[ADDRESS_LENGTH];
+    uint8_t msg[PAYLOAD_LENGTH];
+
+    _stats.frames++;
+    if (len < ADDRESS_LENGTH + PAYLOAD_LENGTH + 2 || !XN297::XN297_Decode(raw, ADDRESS_LENGTH, addr, msg, PAYLOAD_LENGTH)) {
+        _stats.crc_errors++;
+        return false;
+    }
+    if (memcmp(addr, _address, ADDRESS_LENGTH) != 0 || memcmp(msg, _payload, PL_INDEX) != 0) {
+        _stats.foreign++;
+        return false;
+    }
+    return apply(msg);
+}
+
+bool QuntisLamp::apply(const uint8_t* payload) {
+    uint8_t cmd = payload[PL_CMD];
+    uint32_t now = micros();
+
+    if (_has_index && payload[PL_INDEX] == _last_index) {
+        _stats.duplicates++;
+        _index_frames++;
+        _last_frame_us = now;
+
+        // Still held: catch up with the steps the lamp made since the first frame
+        int held = _hold_rate > 0 ? (int)((millis() - _index_ms) * _hold_rate / 1000) : 0;
+        if (cmd == QUNTIS_CMD_ONOFF || held <= _index_steps) {
+            return false;
+        }
+        int count = held - _index_steps;
+        _index_steps = held;
+        return step_(cmd, count);
+    }
+    if (_index_frames > TX_REPEAT) {
+        _hold_gap_us = (_last_frame_us - _index_us) / (_index_frames - 1);
+    }
+    _last_index = payload[PL_INDEX];
+    _has_index = true;
+    _index_ms = millis();
+    _index_us = _last_frame_us = now;
+    _index_frames = 1;
+    _index_steps = 1;
+    _stats.commands++;
+
+    if (cmd == QUNTIS_CMD_ONOFF) {
+        _power = !_power;
+        return true;
+    }
+    return step_(cmd, 1);
+}
+
+bool QuntisLamp::step_(uint8_t cmd, int count) {
+    if (!_power) {
+        _stats.ignored++;
+        return false;
+    }
+
+    int step = (cmd & QUNTIS_CMD_DOWN) ? -count : count;
+    int* value;
+    int max;
+    switch (cmd & ~QUNTIS_CMD_DOWN) {
+        case QUNTIS_CMD_DIM:
+            value = &_brightness;
+            max = _brightness_steps;
+            break;
+        case QUNTIS_CMD_COLOR:
+            value = &_color;
+            max = _color_steps;
+            break;
+        default:
+            return false;
+    }
+
+    int next = std::min(std::max(*value + step, 0), max);
+    if (next == *value) {
+        _stats.clamped++;
+        return false;
+    }
+    *value = next;
+    return true;
+}
+
+void QuntisLamp::reset(bool power, int brightness, int color) {
+    _power = power;
+    _brightness = std::min(std::max(brightness, 0), _brightness_steps);
+    _color = std::min(std::max(color, 0), _color_steps);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+//
+//  QuntisLamp - model of the receiving side of a Quntis ScreenLinear lamp: which frames
+//  it acts on and what they do to its power, brightness and color
+//
+
+#include "quntis_control.h"
+
+class QuntisLamp {
+ public:
+  QuntisLamp(const uint8_t *address, const uint8_t *payload, int brightness_steps, int color_steps);
+
+  // Raw frame as captured in RX (see XN297::XN297_SetRXAddr): decoded, CRC checked and
+  // matched against our address and fixed payload before it is handed to apply()
+  bool accept(const uint8_t *raw, uint8_t len);
+
+  // Decoded payload. The lamp acts once per index, the repeats of a burst carry the same
+  // one. Returns true when the command was new and changed the model.
+  bool apply(const uint8_t *payload);
+
+  void reset(bool power, int brightness, int color);
+
+  // A held button repeats one index for as long as it is held and the lamp keeps stepping
+  // at this rate (see QuntisControl::set_hold_rate). 0 counts every index as a single step.
+  void set_hold_rate(float steps_per_sec) { _hold_rate = steps_per_sec; }
+
+  // Mean frame spacing of the last index that ran past a press burst (TX_REPEAT frames), known
+  // once the next index arrives, 0 before. Frames are timed when they are handed in, so the
+  // receiver has to be drained before its FIFO fills; over a whole hold the polling evens out.
+  uint32_t get_hold_gap_us() const { return _hold_gap_us; }
+
+  // Steps are counted in commands: brightness goes up with Dim(true), color with Color(true).
+  // Both clamp at the end stops, the lamp ignores steps past them.
+  bool get_power() const { return _power; }
+  int get_brightness() const { return _brightness; }
+  int get_color() const { return _color; }
+  uint8_t get_last_index() const { return _last_index; }
+
+  struct Stats {
+    uint32_t frames;      // handed to accept()
+    uint32_t crc_errors;
+    uint32_t foreign;     // other address or fixed payload
+    uint32_t duplicates;  // repeats of an index already acted on
+    uint32_t commands;    // acted on
+    uint32_t clamped;     // steps past an end stop
+    uint32_t ignored;     // steps while off
+  };
+  const Stats &get_stats() const { return _stats; }
+
+ private:
+  bool step_(uint8_t cmd, int count);
+
+  uint8_t _address[ADDRESS_LENGTH];
+  uint8_t _payload[PL_INDEX];
+  int _brightness_steps;
+  int _color_steps;
+
+  bool _power{false};
+  int _brightness{0};
+  int _color{0};
+  uint8_t _last_index{0};
+  bool _has_index{false};
+
+  float _hold_rate{0};
+  uint32_t _index_ms{0};  // first frame of the last index
+  int _index_steps{0};    // steps the last index accounted for
+  uint32_t _index_us{0};  // first and last frame of the last index, for get_hold_gap_us()
+  uint32_t _last_frame_us{0};
+  uint32_t _index_frames{0};
+  uint32_t _hold_gap_us{0};
+
+  Stats _stats{};
+};
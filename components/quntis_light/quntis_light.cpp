@@ -3,15 +3,31 @@
 #include <SPI.h>
 
 #include <algorithm>
+#include <cmath>
 
+#include "esphome/core/application.h"
 #include "esphome/core/hal.h"
 #include "esphome/core/log.h"
+#include "step_journal.h"
 
 namespace esphome {
     namespace quntis_light {
 
         static const char* const TAG = "quntis_light";
 
+        // Targets this close to an end detour through it once a step of error may have built up
+        static const int ANCHOR_NEAR_STEPS = 3;
+        // Beyond this expected error the next move on the axis detours through the cheaper end
+        static const float ANCHOR_MAX_UNCERTAINTY = 3.0f;
+        // Calibration goes this much further than the tracked uncertainty says it has to
+        static const int CALIBRATE_MARGIN_STEPS = 5;
+        // Held calibration ramps run this much longer than the hold rate says, the lamp clamps the rest
+        static const float CALIBRATE_HOLD_SLACK = 1.2f;
+        // Legs this long or longer use a held button when the hold rate is known
+        static const int HOLD_MIN_STEPS = 10;
+        // Share of a hold's steps the lamp may be off by, the measured rate isn't exact
+        static const float HOLD_RATE_ERROR = 0.1f;
+
         void QuntisLight::setup() {
             ESP_LOGI(TAG, "Setting up Quntis Light Output...");
 
@@ -26,6 +42,13 @@ namespace esphome {
                 this->mark_failed();
                 return;
             }
+            restore_journal_();
+
+            if (listen_remote_) {
+                remote_.reset(new QuntisLamp(controller_.get_address(), controller_.get_payload(), brightness_steps_,
+                                             color_temp_steps_));
+                controller_.set_rx_callback([this](const uint8_t* raw, uint8_t len) { this->on_remote_frame_(raw, len); });
+            }
 
             ESP_LOGI(TAG, "Quntis Light Output ready");
         }
@@ -44,6 +67,13 @@ namespace esphome {
             ESP_LOGCONFIG(TAG, "  Color Temp Steps: %d", color_temp_steps_);
             ESP_LOGCONFIG(TAG, "  Color Temp Range: %.0f - %.0f mireds", min_mireds_, max_mireds_);
             ESP_LOGCONFIG(TAG, "  Step Delay: %d ms", step_delay_ms_);
+            ESP_LOGCONFIG(TAG, "  Repeat Gap: %u us", (unsigned)controller_.get_repeat_gap());
+            ESP_LOGCONFIG(TAG, "  Repeat Count: %u (%u for intermediate steps at %.0f%% frame loss)",
+                          (unsigned)controller_.get_repeat_count(), (unsigned)controller_.get_step_repeat(),
+                          controller_.get_loss_estimate() * 100);
+            ESP_LOGCONFIG(TAG, "  Carrier Sense: %s", YESNO(controller_.get_carrier_sense()));
+            ESP_LOGCONFIG(TAG, "  Listen for Remote: %s", YESNO(listen_remote_));
+            ESP_LOGCONFIG(TAG, "  Hold Rate: %.1f steps/s", controller_.get_hold_rate());
         }
 
         light::LightTraits QuntisLight::get_traits() {
@@ -54,13 +84,31 @@ namespace esphome {
             return traits;
         }
 
+        std::unique_ptr<light::LightTransformer> QuntisLight::create_default_transition() {
+            return std::unique_ptr<light::LightTransformer>(new QuntisTransition(this));
+        }
+
         void QuntisLight::write_state(light::LightState* state) {
             light_state_ = state;
 
-            bool is_on = state->current_values.is_on();
+            // The running QuntisTransition already queued the target, the values in between are our own steps
+            if (state->is_transformer_active()) return;
             float brightness;
             state->current_values_as_brightness(&brightness);
-            float color_temp = state->current_values.get_color_temperature();
+            apply_values_(state->current_values, brightness, 0);
+        }
+
+        void QuntisLight::start_transition(const light::LightColorValues& target, uint32_t length_ms) {
+            ESP_LOGD(TAG, "Transition over %u ms", (unsigned)length_ms);
+            // The gamma current_values_as_brightness() applies in write_state()
+            float brightness;
+            target.as_brightness(&brightness, light_state_ ? light_state_->get_gamma_correct() : 0);
+            apply_values_(target, brightness, length_ms);
+        }
+
+        void QuntisLight::apply_values_(const light::LightColorValues& values, float brightness, uint32_t length_ms) {
+            bool is_on = values.is_on();
+            float color_temp = values.get_color_temperature();
 
             int target_brightness = std::min((int)(brightness * brightness_steps_), brightness_steps_);
             int target_color = std::min(mireds_to_percent_(color_temp) * color_temp_steps_ / 100, color_temp_steps_);
@@ -71,6 +119,14 @@ namespace esphome {
             // On first write after boot, sync internal state to ESPHome's stored values (without sending RF commands)
             if (first_write_) {
                 first_write_ = false;
+                if (journal_restored_) {
+                    // The journal is newer than the restored values, finish its ramp and publish where the lamp is
+                    ESP_LOGI(TAG, "Initial state from step journal, ignoring restored on=%s brightness_step=%d color_step=%d",
+                             ONOFF(is_on), target_brightness, target_color);
+                    if (op_state_ == IDLE) process_state_machine_();
+                    if (op_state_ == IDLE) needs_state_publish_ = true;
+                    return;
+                }
                 current_power_ = is_on;
                 current_brightness_step_ = target_brightness;
                 current_color_step_ = target_color;
@@ -79,38 +135,73 @@ namespace esphome {
                 return;
             }
 
-            // Handle power change
+            // Settle latency only means something for changes that go out as fast as they can
+            last_write_time_ = millis();
+            latency_pending_ = length_ms == 0;
+
+            // Every new target restarts the pacing, a short transition is no slower than none
+            pace_length_ms_ = length_ms > step_delay_ms_ ? length_ms : 0;
+            pace_start_ = last_write_time_;
+            brightness_sent_ = 0;
+            color_sent_ = 0;
+
+            // Handle power change, it preempts a running ramp instead of waiting behind it
             if (is_on != current_power_) {
                 target_power_ = is_on;
                 has_pending_power_ = true;
+                if (op_state_ == SENDING_STEPS) {
+                    preempt_steps_();
+                }
             }
 
-            // Color and brightness
+            // Color and brightness, a running transition follows the new target right away
             if (is_on) {
                 queue_target_(target_brightness, target_brightness_step_, has_pending_brightness_,
-                              current_brightness_step_, "brightness");
+                              current_brightness_step_, remaining_brightness_steps_, brightness_up_, brightness_anchor_,
+                              "brightness");
                 queue_target_(target_color, target_color_step_, has_pending_color_,
-                              current_color_step_, "color");
+                              current_color_step_, remaining_color_steps_, color_up_, color_anchor_, "color");
             }
 
             if (op_state_ == IDLE) {
                 process_state_machine_();
             }
+            journal_();
         }
 
         //
         // State machine for ESPHome to handle multi-step transitions
         //
         void QuntisLight::loop() {
+            controller_.poll_rx();
+
             if (needs_state_publish_) {
                 needs_state_publish_ = false;
                 publish_current_state_();
             }
 
+            // A power toggle the full RF queue turned away
+            if (op_state_ == IDLE && has_pending_power_ && controller_.is_tx_idle()) {
+                process_state_machine_();
+            }
+
             uint32_t now = millis();
+            if (latency_pending_ && op_state_ == IDLE && controller_.is_tx_idle()) {
+                latency_pending_ = false;
+                last_latency_ms_ = now - last_write_time_;
+                max_latency_ms_ = std::max(max_latency_ms_, last_latency_ms_);
+                latency_count_++;
+                ESP_LOGD(TAG, "Settle latency: %u ms (max %u ms over %u changes)",
+                         (unsigned)last_latency_ms_, (unsigned)max_latency_ms_, (unsigned)latency_count_);
+            }
+
             if (op_state_ == IDLE || now - last_step_time_ < step_delay_ms_) {
                 return;
             }
+            // Two bursts per step can take longer than step_delay, don't let the RF queue run ahead
+            if ((op_state_ == SENDING_STEPS || op_state_ == HOLDING) && !controller_.is_tx_idle()) {
+                return;
+            }
 
             last_step_time_ = now;
             bool done = false;
@@ -123,12 +214,18 @@ namespace esphome {
                     done = true;
                     break;
 
-                case SENDING_BRIGHTNESS:
-                    done = send_step_(true);
+                case SENDING_STEPS:
+                    done = send_steps_();
                     break;
 
-                case SENDING_COLOR_TEMP:
-                    done = send_step_(false);
+                case HOLDING:
+                    // The ramps ran past both end stops
+                    current_brightness_step_ = brightness_anchor_.end;
+                    current_color_step_ = color_anchor_.end;
+                    brightness_anchor_ = Anchor();
+                    color_anchor_ = Anchor();
+                    journal_();
+                    done = true;
                     break;
 
                 default:
@@ -140,71 +237,285 @@ namespace esphome {
                 process_state_machine_();
                 if (op_state_ == IDLE) {
                     needs_state_publish_ = true;
+                    ESP_LOGD(TAG, "RF stats: %s", controller_.get_rf_info().c_str());
                 }
             }
         }
 
         void QuntisLight::process_state_machine_() {
-            // Priority: power > brightness > color temp
+            // Power first, the lamp ignores steps while off
             if (has_pending_power_) {
+                // A full RF queue turned it away, loop() tries again once the radio is idle
+                if (!controller_.OnOff()) return;
                 ESP_LOGI(TAG, "Toggling power to %s", ONOFF(target_power_));
-                controller_.OnOff();
                 op_state_ = TOGGLING_POWER;
                 last_step_time_ = millis();
+                journal_();
                 return;
             }
 
-            if (start_transition_(has_pending_brightness_, current_brightness_step_,
-                                  target_brightness_step_, SENDING_BRIGHTNESS, "brightness")) return;
-            if (start_transition_(has_pending_color_, current_color_step_,
-                                  target_color_step_, SENDING_COLOR_TEMP, "color")) return;
+            // Brightness and color run side by side, so a scene change takes max() instead of the sum of both
+            bool brightness = start_axis_(has_pending_brightness_, current_brightness_step_, target_brightness_step_,
+                                          remaining_brightness_steps_, brightness_up_, brightness_anchor_,
+                                          brightness_steps_, "brightness");
+            bool color = start_axis_(has_pending_color_, current_color_step_, target_color_step_,
+                                     remaining_color_steps_, color_up_, color_anchor_, color_temp_steps_, "color");
+            if (brightness || color) {
+                transition_start_ = millis();
+                transition_eta_ms_ = plan_eta_();
+                op_state_ = SENDING_STEPS;
+                last_step_time_ = 0;
+                ESP_LOGI(TAG, "Starting transition: brightness %d -> %d, color %d -> %d, ETA %u ms",
+                         current_brightness_step_, brightness ? target_brightness_step_ : current_brightness_step_,
+                         current_color_step_, color ? target_color_step_ : current_color_step_,
+                         (unsigned)transition_eta_ms_);
+                return;
+            }
 
             // Nothing pending, stay idle
             op_state_ = IDLE;
             if (is_calibrating_) {
                 is_calibrating_ = false;
-                ESP_LOGI(TAG, "Calibration complete: brightness=%d, color=%d", current_brightness_step_, current_color_step_);
-            }
-        }
-
-        bool QuntisLight::send_step_(bool is_brightness) {
-            int& current_step = is_brightness ? current_brightness_step_ : current_color_step_;
-            const char* label = is_brightness ? "Brightness" : "Color";
-
-            if (remaining_steps_ > 0) {
-                if (is_brightness)
-                    controller_.Dim(step_direction_, true);
-                else
-                    controller_.Color(step_direction_, true);
-                remaining_steps_--;
-                current_step += step_direction_ ? 1 : -1;
-                ESP_LOGV(TAG, "%s step: %s, remaining=%d, current=%d",
-                         label,
-                         is_brightness ? (step_direction_ ? "UP" : "DOWN")
-                                       : (step_direction_ ? "COLDER" : "WARMER"),
-                         remaining_steps_, current_step);
-            }
-            if (remaining_steps_ <= 0) {
-                int target = is_brightness ? target_brightness_step_ : target_color_step_;
-                bool pending = is_brightness ? has_pending_brightness_ : has_pending_color_;
-                ESP_LOGI(TAG, "%s transition done: current=%d, target=%d, pending=%s",
-                         label, current_step, target, YESNO(pending));
-                return true;
+                last_calibration_ms_ = millis() - calibration_start_;
+                ESP_LOGI(TAG, "Calibration complete in %u ms: brightness=%d, color=%d", (unsigned)last_calibration_ms_,
+                         current_brightness_step_, current_color_step_);
             }
-            return false;
         }
 
-        bool QuntisLight::start_transition_(bool& pending, int current, int target,
-                                            OperationState state, const char* label) {
+        // One DIM and one COLOR burst per call, queued back to back on the controller
+        bool QuntisLight::send_steps_() {
+            // All but the last step of a ramp may go out with fewer copies, see Dim()
+            uint8_t queued = 0;
+            // A step the full RF queue turns away goes out on a later loop
+            if (remaining_brightness_steps_ > 0 && step_due_(brightness_sent_, remaining_brightness_steps_)) {
+                bool intermediate = remaining_brightness_steps_ > 1;
+                uint32_t hold_ms = hold_ms_(remaining_brightness_steps_, brightness_anchor_);
+                if (hold_ms > 0) {
+                    if (controller_.ramp(QUNTIS_CMD_DIM, brightness_up_, hold_ms)) {
+                        queued |= JOURNAL_QUEUED_BRIGHTNESS;
+                        track_hold_(current_brightness_step_, remaining_brightness_steps_, brightness_sent_, brightness_up_,
+                                    brightness_anchor_, brightness_steps_);
+                    }
+                } else if (controller_.Dim(brightness_up_, true, 0, intermediate)) {
+                    remaining_brightness_steps_--;
+                    brightness_sent_++;
+                    queued |= JOURNAL_QUEUED_BRIGHTNESS;
+                    track_step_(current_brightness_step_, brightness_up_, brightness_anchor_, brightness_steps_, intermediate);
+                }
+            }
+            if (remaining_color_steps_ > 0 && step_due_(color_sent_, remaining_color_steps_)) {
+                bool intermediate = remaining_color_steps_ > 1;
+                uint32_t hold_ms = hold_ms_(remaining_color_steps_, color_anchor_);
+                if (hold_ms > 0) {
+                    if (controller_.ramp(QUNTIS_CMD_COLOR, color_up_, hold_ms)) {
+                        queued |= JOURNAL_QUEUED_COLOR;
+                        track_hold_(current_color_step_, remaining_color_steps_, color_sent_, color_up_, color_anchor_,
+                                    color_temp_steps_);
+                    }
+                } else if (controller_.Color(color_up_, true, 0, intermediate)) {
+                    remaining_color_steps_--;
+                    color_sent_++;
+                    queued |= JOURNAL_QUEUED_COLOR;
+                    track_step_(current_color_step_, color_up_, color_anchor_, color_temp_steps_, intermediate);
+                }
+            }
+            if (queued) last_queued_axes_ = queued;
+
+            // An overshoot leg that ended puts the axis at a known end, the rest of the move starts from there
+            finish_anchor_(has_pending_brightness_, current_brightness_step_, target_brightness_step_,
+                           remaining_brightness_steps_, brightness_up_, brightness_anchor_, brightness_steps_, "brightness");
+            finish_anchor_(has_pending_color_, current_color_step_, target_color_step_, remaining_color_steps_, color_up_,
+                           color_anchor_, color_temp_steps_, "color");
+            journal_();
+            ESP_LOGV(TAG, "Step: brightness=%d (%d left %s), color=%d (%d left %s)",
+                     current_brightness_step_, remaining_brightness_steps_, brightness_up_ ? "UP" : "DOWN",
+                     current_color_step_, remaining_color_steps_, color_up_ ? "COLDER" : "WARMER");
+
+            if (remaining_brightness_steps_ > 0 || remaining_color_steps_ > 0) {
+                return false;
+            }
+            ESP_LOGI(TAG, "Transition done in %u ms (ETA %u ms): brightness=%d (+-%.1f), color=%d (+-%.1f)",
+                     (unsigned)(millis() - transition_start_), (unsigned)transition_eta_ms_, current_brightness_step_,
+                     brightness_anchor_.uncertainty, current_color_step_, color_anchor_.uncertainty);
+            return true;
+        }
+
+        // In a transition with a length, the k-th step of an axis goes out once k/n of it has passed. n counts
+        // what was sent since the target was set plus what is left, so it follows retargets and anchor legs.
+        bool QuntisLight::step_due_(int sent, int remaining) {
+            if (pace_length_ms_ == 0) return true;
+            return (uint64_t)(sent + 1) * pace_length_ms_ <= (uint64_t)(millis() - pace_start_) * (sent + remaining);
+        }
+
+        // A leg of HOLD_MIN_STEPS or more goes out as one held button when the hold rate is known and that beats
+        // single steps, as in MqttManager::stepAxis. A leg into an end stop holds longer by the hold's own error,
+        // the lamp clamps the rest. 0 for single steps, always in a transition with a length.
+        uint32_t QuntisLight::hold_ms_(int remaining, const Anchor& anchor) {
+            float rate = controller_.get_hold_rate();
+            if (rate <= 0 || pace_length_ms_ > 0 || remaining < HOLD_MIN_STEPS) return 0;
+            float steps = anchor.end >= 0 ? remaining * (1 + HOLD_RATE_ERROR) : remaining;
+            uint32_t hold_ms = (uint32_t)(steps * 1000 / rate);
+            return hold_ms < remaining * step_period_ms_(1) ? hold_ms : 0;
+        }
+
+        // The held leg is done once it is queued. Into an end stop the lamp lands there and finish_anchor_() takes
+        // over, anywhere else the hold adds its error, which the next leg into an end stop runs out.
+        void QuntisLight::track_hold_(int& current, int& remaining, int& sent, bool up, Anchor& anchor, int max) {
+            current = std::min(std::max(current + (up ? remaining : -remaining), 0), max);
+            if (anchor.end < 0) {
+                anchor.hold_error = std::min(anchor.hold_error + remaining * HOLD_RATE_ERROR, (float)max);
+            }
+            sent += remaining;
+            remaining = 0;
+        }
+
+        // loop() queues the next step once step_delay passed and the radio is idle again, so a step takes the
+        // longer of both, rounded up to the loop that sees it
+        uint32_t QuntisLight::step_period_ms_(int bursts) {
+            uint32_t busy_ms = (bursts * controller_.get_burst_us(controller_.get_step_repeat()) + 999) / 1000;
+            uint32_t loop_ms = std::max<uint32_t>(App.get_loop_interval(), 1);
+            return (std::max(step_delay_ms_, busy_ms) + loop_ms - 1) / loop_ms * loop_ms;
+        }
+
+        // From the first step until the last is queued, both axes side by side: a DIM and a COLOR burst per step
+        // until the shorter axis is done
+        uint32_t QuntisLight::steps_ms_(int brightness, int color) {
+            int both = std::min(brightness, color);
+            int single = std::max(brightness, color) - both;
+            if (both + single == 0) return 0;
+            return both * step_period_ms_(2) + single * step_period_ms_(1) - step_period_ms_(single > 0 ? 1 : 2);
+        }
+
+        // Time from the start of the transition until the last of the remaining steps is queued. The first step
+        // goes out on the next loop, a retarget mid-transition waits out the period of the step before it. Held
+        // legs keep the radio for their length, single steps queue behind them, and a leg into an end stop comes
+        // back to the target in single steps.
+        uint32_t QuntisLight::plan_eta_() {
+            uint32_t now = millis();
+            uint32_t wait = App.get_loop_interval();
+            if (last_step_time_ != 0) {
+                int bursts = last_queued_axes_ == (JOURNAL_QUEUED_BRIGHTNESS | JOURNAL_QUEUED_COLOR) ? 2 : 1;
+                uint32_t period = step_period_ms_(bursts);
+                wait = now - last_step_time_ < period ? period - (now - last_step_time_) : 0;
+            }
+            uint32_t brightness_hold = hold_ms_(remaining_brightness_steps_, brightness_anchor_);
+            uint32_t color_hold = hold_ms_(remaining_color_steps_, color_anchor_);
+            int brightness_steps = (brightness_hold ? 0 : remaining_brightness_steps_) +
+                                   (brightness_anchor_.end >= 0 ? abs(brightness_anchor_.end - target_brightness_step_) : 0);
+            int color_steps = (color_hold ? 0 : remaining_color_steps_) +
+                              (color_anchor_.end >= 0 ? abs(color_anchor_.end - target_color_step_) : 0);
+            uint32_t hold_ms = brightness_hold + color_hold;
+            if (hold_ms > 0) {
+                // The last held frame leaves the radio busy a little longer, the next step waits for the loop after
+                uint32_t loop_ms = std::max<uint32_t>(App.get_loop_interval(), 1);
+                hold_ms = (hold_ms + (controller_.get_burst_us(1) + 999) / 1000 + loop_ms - 1) / loop_ms * loop_ms;
+            }
+            uint32_t eta = (now - transition_start_) + wait + hold_ms + steps_ms_(brightness_steps, color_steps);
+            if (pace_length_ms_ > 0) {
+                eta = std::max(eta, pace_start_ + pace_length_ms_ - transition_start_);
+            }
+            return eta;
+        }
+
+        // Drop the rest of the running ramp so a power change goes out next. Steps already queued on
+        // the controller still go out first, they are at most one step pair.
+        void QuntisLight::preempt_steps_() {
+            ESP_LOGI(TAG, "Power %s preempts transition at brightness=%d (%d left), color=%d (%d left)",
+                     ONOFF(target_power_), current_brightness_step_, remaining_brightness_steps_,
+                     current_color_step_, remaining_color_steps_);
+            remaining_brightness_steps_ = 0;
+            remaining_color_steps_ = 0;
+            brightness_anchor_.end = -1;
+            color_anchor_.end = -1;
+            if (!target_power_) {
+                // Stepping an off lamp does nothing, the next write_state with on=true queues them again
+                has_pending_brightness_ = false;
+                has_pending_color_ = false;
+            }
+            op_state_ = IDLE;
+            process_state_machine_();
+        }
+
+        // Frame heard from the original remote: replay it on the tracked state. The remote wins over a
+        // running transition on the axis it moved, HA gets the new state once we are idle.
+        void QuntisLight::on_remote_frame_(const uint8_t* raw, uint8_t len) {
+            remote_->set_hold_rate(controller_.get_hold_rate());
+            remote_->reset(current_power_, current_brightness_step_, current_color_step_);
+            bool changed = remote_->accept(raw, len);
+
+            // Our ramps stream at the cadence of the remote's last held button
+            uint32_t hold_gap = remote_->get_hold_gap_us();
+            if (hold_gap != 0 && hold_gap != controller_.get_hold_gap()) {
+                controller_.set_hold_gap(hold_gap);
+                ESP_LOGI(TAG, "Remote holds at one frame per %uus, ramps follow it", (unsigned)hold_gap);
+            }
+            if (!changed) return;
+
+            if (remote_->get_power() != current_power_) {
+                current_power_ = remote_->get_power();
+                if (has_pending_power_ && target_power_ == current_power_) {
+                    has_pending_power_ = false;
+                }
+                if (!current_power_) {
+                    remaining_brightness_steps_ = 0;
+                    remaining_color_steps_ = 0;
+                    brightness_anchor_.end = -1;
+                    color_anchor_.end = -1;
+                    has_pending_brightness_ = false;
+                    has_pending_color_ = false;
+                }
+            }
+            if (remote_->get_brightness() != current_brightness_step_) {
+                current_brightness_step_ = remote_->get_brightness();
+                remaining_brightness_steps_ = 0;
+                brightness_anchor_.end = -1;
+                has_pending_brightness_ = false;
+            }
+            if (remote_->get_color() != current_color_step_) {
+                current_color_step_ = remote_->get_color();
+                remaining_color_steps_ = 0;
+                color_anchor_.end = -1;
+                has_pending_color_ = false;
+            }
+            ESP_LOGI(TAG, "Remote idx=%u: on=%s brightness=%d color=%d", (unsigned)remote_->get_last_index(),
+                     ONOFF(current_power_), current_brightness_step_, current_color_step_);
+            journal_();
+
+            // A running transition publishes when it ends, publishing now would retarget it
+            if (op_state_ == IDLE) {
+                needs_state_publish_ = true;
+            }
+        }
+
+        bool QuntisLight::start_axis_(bool& pending, int current, int target, int& remaining, bool& up, Anchor& anchor,
+                                      int max, const char* label) {
+            remaining = 0;
             if (!pending) return false;
+
+            // First leg runs past the end stop by the expected error, the lamp clamps there. A held move ends in
+            // the end stop past its target when that is close: the end stop absorbs the hold's error and single
+            // steps finish the move.
+            int end = plan_anchor_(anchor, current, target, max);
+            int past = target > current ? max : 0;
+            if (end < 0 && target != current && abs(past - target) < HOLD_MIN_STEPS &&
+                hold_ms_(abs(target - current), anchor) > 0) {
+                end = past;
+            }
+            if (end >= 0) {
+                int overshoot = (int)std::ceil(anchor.uncertainty + anchor.hold_error);
+                anchor.end = end;
+                up = (end == max);
+                remaining = std::min(abs(end - current) + overshoot, max);  // a full sweep always gets there
+                ESP_LOGD(TAG, "Planning %s: %d -> %d via end stop %d (+%d past it, +-%.1f steps)", label, current, target,
+                         end, overshoot, anchor.uncertainty + anchor.hold_error);
+                return true;
+            }
+
             int diff = target - current;
             if (diff != 0) {
-                step_direction_ = (diff > 0);
-                remaining_steps_ = abs(diff);
-                op_state_ = state;
-                last_step_time_ = 0;
-                ESP_LOGI(TAG, "Starting %s transition: %d -> %d (%d steps %s)",
-                         label, current, target, remaining_steps_, step_direction_ ? "up" : "down");
+                up = (diff > 0);
+                remaining = abs(diff);
+                ESP_LOGD(TAG, "Planning %s: %d -> %d (%d steps %s)", label, current, target, remaining, up ? "up" : "down");
                 return true;
             }
             pending = false;
@@ -212,22 +523,111 @@ namespace esphome {
             return false;
         }
 
-        void QuntisLight::queue_target_(int target, int& target_step, bool& pending,
-                                        int current, const char* label) {
-            if (target != current) {
-                if (pending && op_state_ != IDLE) {
-                    ESP_LOGI(TAG, "Pending %s overwritten: %d -> %d (was targeting %d)",
-                             label, current, target, target_step);
+        // End stop to detour through for a move, -1 to go straight. Moves to an end always overshoot a
+        // little, moves near an end only once a step of error may have built up, others once it is too large.
+        int QuntisLight::plan_anchor_(const Anchor& anchor, int current, int target, int max) {
+            if (anchor.uncertainty <= 0 && anchor.hold_error <= 0) return -1;
+            if (target == 0 || target == max) return target;
+            if (anchor.uncertainty <= 0) return -1;
+
+            int near = target <= max - target ? 0 : max;
+            if (anchor.uncertainty >= 1 && abs(target - near) <= ANCHOR_NEAR_STEPS && abs(current - near) > abs(target - near)) {
+                return near;
+            }
+            if (anchor.uncertainty >= ANCHOR_MAX_UNCERTAINTY) {
+                int via_low = current + target;
+                int via_high = (max - current) + (max - target);
+                return via_low <= via_high ? 0 : max;
+            }
+            return -1;
+        }
+
+        // A lost burst leaves the lamp a step off, it happens with (frame loss ^ copies) chance
+        void QuntisLight::track_step_(int& current, bool up, Anchor& anchor, int max, bool intermediate) {
+            current = std::min(std::max(current + (up ? 1 : -1), 0), max);
+            int copies = intermediate ? controller_.get_step_repeat() : controller_.get_repeat_count();
+            anchor.uncertainty = std::min(anchor.uncertainty + std::pow(controller_.get_loss_estimate(), (float)copies), (float)max);
+        }
+
+        void QuntisLight::finish_anchor_(bool& pending, int& current, int target, int& remaining, bool& up, Anchor& anchor,
+                                         int max, const char* label) {
+            if (anchor.end < 0 || remaining > 0) return;
+
+            current = anchor.end;
+            anchor.end = -1;
+            anchor.uncertainty = 0;
+            anchor.hold_error = 0;
+            ESP_LOGD(TAG, "Re-anchored %s at end stop %d", label, current);
+            start_axis_(pending, current, target, remaining, up, anchor, max, label);
+        }
+
+        void QuntisLight::queue_target_(int target, int& target_step, bool& pending, int current, int& remaining,
+                                        bool& up, const Anchor& anchor, const char* label) {
+            // Back at the current step only matters when a transition is heading elsewhere
+            if (target == current && !pending) return;
+
+            if (pending && target != target_step) {
+                ESP_LOGI(TAG, "Pending %s retargeted: %d -> %d (was targeting %d)", label, current, target, target_step);
+            }
+            target_step = target;
+            pending = true;
+
+            // Recompute the running transition in place, including reversing direction. An overshoot leg
+            // runs to its end, the next leg heads for the new target.
+            if (op_state_ == SENDING_STEPS && anchor.end < 0) {
+                int diff = target - current;
+                if (remaining > 0 && diff != 0 && (diff > 0) != up) {
+                    ESP_LOGD(TAG, "Reversing %s at %d", label, current);
                 }
-                target_step = target;
-                pending = true;
+                up = (diff > 0);
+                remaining = abs(diff);
+                transition_eta_ms_ = plan_eta_();
             }
         }
 
+        // Written after every command the controller queues, a toggle counts as done once it is queued
+        void QuntisLight::journal_() {
+            StepJournal::append(op_state_ == TOGGLING_POWER ? target_power_ : current_power_, current_brightness_step_,
+                                current_color_step_,
+                                has_pending_brightness_ ? target_brightness_step_ : current_brightness_step_,
+                                has_pending_color_ ? target_color_step_ : current_color_step_, last_queued_axes_,
+                                controller_.get_index());
+        }
+
+        // After a reset that kept RTC memory (crash, watchdog, brownout, OTA) the lamp is where the journal
+        // says, an interrupted ramp goes on from there instead of needing a calibration
+        void QuntisLight::restore_journal_() {
+            StepJournal::Record record;
+            if (!StepJournal::restore(record)) return;
+
+            current_power_ = record.power;
+            current_brightness_step_ = std::min((int)record.brightness, brightness_steps_);
+            current_color_step_ = std::min((int)record.color, color_temp_steps_);
+            target_brightness_step_ = std::min((int)record.brightness_target, brightness_steps_);
+            target_color_step_ = std::min((int)record.color_target, color_temp_steps_);
+            has_pending_brightness_ = current_power_ && target_brightness_step_ != current_brightness_step_;
+            has_pending_color_ = current_power_ && target_color_step_ != current_color_step_;
+
+            // The last step queued may not have made it on air before the reset, whether or not the ramp was done
+            last_queued_axes_ = record.queued;
+            if (has_pending_brightness_ || (record.queued & JOURNAL_QUEUED_BRIGHTNESS)) brightness_anchor_.uncertainty = 1;
+            if (has_pending_color_ || (record.queued & JOURNAL_QUEUED_COLOR)) color_anchor_.uncertainty = 1;
+
+            // Its index may have, the lamp drops a command that reuses it
+            controller_.set_index(record.index + 1);
+            journal_restored_ = true;
+
+            ESP_LOGI(TAG, "Restored from step journal: on=%s brightness=%d -> %d, color=%d -> %d, index %u",
+                     ONOFF(current_power_), current_brightness_step_, target_brightness_step_, current_color_step_,
+                     target_color_step_, (unsigned)(uint8_t)(record.index + 1));
+        }
+
         void QuntisLight::publish_current_state_() {
             if (!light_state_) return;
 
+            // Instant, a transition would send the steps we already took again
             auto call = light_state_->make_call();
+            call.set_transition_length(0);
             call.set_state(current_power_);
             if (current_power_) {
                 // Quantize brightness to our step grid; ensure non-zero when on (step 0 = dimmest, not off)
@@ -242,6 +642,33 @@ namespace esphome {
                      ONOFF(current_power_), current_brightness_step_, current_color_step_);
         }
 
+        void QuntisLight::fill_tracked_values(light::LightColorValues& values) {
+            values.set_brightness(std::max((float)current_brightness_step_ / brightness_steps_, 1.0f / brightness_steps_));
+            values.set_color_temperature(percent_to_mireds_((current_color_step_ * 100) / color_temp_steps_));
+        }
+
+        void QuntisTransition::start() {
+            light_->start_transition(this->target_values_, this->length_);
+        }
+
+        // Over when the steps are out, which with the pacing is about the requested length
+        bool QuntisTransition::is_finished() {
+            return light_->is_idle();
+        }
+
+        // Only report a change, every value returned here becomes a write_state() call
+        optional<light::LightColorValues> QuntisTransition::apply() {
+            if (light_->get_brightness_step() == last_brightness_step_ && light_->get_color_step() == last_color_step_) {
+                return {};
+            }
+            last_brightness_step_ = light_->get_brightness_step();
+            last_color_step_ = light_->get_color_step();
+
+            light::LightColorValues values = this->target_values_;
+            light_->fill_tracked_values(values);
+            return values;
+        }
+
         //
         // HomeAssistent uses mireds for color temperature, for us a simple percentage is easier
         // Inverted mapping: high mireds (warm) → 0%, low mireds (cold) → 100%
@@ -259,28 +686,72 @@ namespace esphome {
         //
         // Calibration and power override
         //
-        void QuntisLight::calibrate() {
+        void QuntisLight::calibrate(bool full) {
             if (is_calibrating_) {
                 ESP_LOGW(TAG, "Calibration already in progress, ignoring");
                 return;
             }
 
-            ESP_LOGI(TAG, "Calibrating: sending %d dim-down + %d color-cold steps to reach known minimum",
-                     brightness_steps_, color_temp_steps_);
+            // Each axis heads for the end stop it reaches soonest in the worst case
+            float brightness_error = full ? brightness_steps_ : brightness_anchor_.uncertainty + CALIBRATE_MARGIN_STEPS;
+            float color_error = full ? color_temp_steps_ : color_anchor_.uncertainty + CALIBRATE_MARGIN_STEPS;
+            int brightness_end = current_brightness_step_ <= brightness_steps_ - current_brightness_step_ ? 0 : brightness_steps_;
+            int color_end = current_color_step_ <= color_temp_steps_ - current_color_step_ ? 0 : color_temp_steps_;
+            int brightness_need = std::min(abs(brightness_end - current_brightness_step_) + (int)std::ceil(brightness_error),
+                                           brightness_steps_);
+            int color_need = std::min(abs(color_end - current_color_step_) + (int)std::ceil(color_error), color_temp_steps_);
+
+            // Single steps of both axes interleave, held buttons are faster per axis but go one after the other
+            uint32_t steps_ms = steps_ms_(brightness_need, color_need);
+            float rate = controller_.get_hold_rate();
+            uint32_t hold_ms = rate > 0 ? (uint32_t)((brightness_need + color_need) * 1000 * CALIBRATE_HOLD_SLACK / rate)
+                                        : UINT32_MAX;
+            bool hold = hold_ms < steps_ms && op_state_ != TOGGLING_POWER;
+
+            ESP_LOGI(TAG, "Calibrating%s: brightness %d -> end %d (%d steps), color %d -> end %d (%d steps), %s, ETA %u ms",
+                     full ? " (full)" : "", current_brightness_step_, brightness_end, brightness_need, current_color_step_,
+                     color_end, color_need, hold ? "held" : "single steps", (unsigned)(hold ? hold_ms : steps_ms));
 
             is_calibrating_ = true;
-
-            // Assume worst case: lamp is at max brightness and warmest color
-            current_brightness_step_ = brightness_steps_;
-            current_color_step_ = 0;
+            calibration_start_ = millis();
             current_power_ = true;
+            remaining_brightness_steps_ = 0;
+            remaining_color_steps_ = 0;
+            target_brightness_step_ = brightness_end;
+            target_color_step_ = color_end;
+
+            // A running transition was planned from the old assumed state, start over
+            if (op_state_ == SENDING_STEPS) {
+                op_state_ = IDLE;
+            }
 
-            // Target: minimum brightness, coldest color temp
-            target_brightness_step_ = 0;
-            target_color_step_ = color_temp_steps_;
+            if (hold) {
+                last_queued_axes_ = 0;
+                if (brightness_need > 0) {
+                    controller_.ramp(QUNTIS_CMD_DIM, brightness_end != 0,
+                                     (uint32_t)(brightness_need * 1000 * CALIBRATE_HOLD_SLACK / rate));
+                    last_queued_axes_ |= JOURNAL_QUEUED_BRIGHTNESS;
+                }
+                if (color_need > 0) {
+                    controller_.ramp(QUNTIS_CMD_COLOR, color_end != 0, (uint32_t)(color_need * 1000 * CALIBRATE_HOLD_SLACK / rate));
+                    last_queued_axes_ |= JOURNAL_QUEUED_COLOR;
+                }
+                brightness_anchor_.end = brightness_end;
+                color_anchor_.end = color_end;
+                has_pending_brightness_ = false;
+                has_pending_color_ = false;
+                op_state_ = HOLDING;
+                last_step_time_ = 0;
+                return;
+            }
+
+            // Single steps: an overshoot leg per axis (see plan_anchor_), the error sizes the overshoot
+            brightness_anchor_ = Anchor();
+            color_anchor_ = Anchor();
+            brightness_anchor_.uncertainty = brightness_error;
+            color_anchor_.uncertainty = color_error;
             has_pending_brightness_ = true;
             has_pending_color_ = true;
-
             if (op_state_ == IDLE) {
                 process_state_machine_();
             }
@@ -1,15 +1,34 @@
 #pragma once
 
+#include <memory>
 #include <vector>
 
 #include "esphome/components/light/light_output.h"
 #include "esphome/core/component.h"
 #include "esphome/core/log.h"
 #include "quntis_control.h"
+#include "quntis_lamp.h"
 
 namespace esphome {
     namespace quntis_light {
 
+        class QuntisLight;
+
+        // Hands the target and length of a light call to QuntisLight, which spreads the RF steps over it.
+        // LightState shows the tracked steps meanwhile, not interpolated values the lamp isn't at.
+        class QuntisTransition : public light::LightTransformer {
+           public:
+            explicit QuntisTransition(QuntisLight* light) : light_(light) {}
+            void start() override;
+            bool is_finished() override;
+            optional<light::LightColorValues> apply() override;
+
+           protected:
+            QuntisLight* light_;
+            int last_brightness_step_{-1};
+            int last_color_step_{-1};
+        };
+
         class QuntisLight : public light::LightOutput, public Component {
            public:
             void setup() override;
@@ -18,10 +37,30 @@ namespace esphome {
             float get_setup_priority() const override { return setup_priority::HARDWARE; }
 
             light::LightTraits get_traits() override;
+            void setup_state(light::LightState* state) override { light_state_ = state; }
             void write_state(light::LightState* state) override;
-            void calibrate();
+            std::unique_ptr<light::LightTransformer> create_default_transition() override;
+            // Queues the target of a transition, its steps are spread over length_ms (see step_due_)
+            void start_transition(const light::LightColorValues& target, uint32_t length_ms);
+            // Tracked steps as light values, on top of the state in values
+            void fill_tracked_values(light::LightColorValues& values);
+            bool is_idle() const { return op_state_ == IDLE; }
+            // The last burst queued is off the radio
+            bool is_tx_idle() const { return controller_.is_tx_idle(); }
+            // Frame spacing of held legs, the remote's once it was heard holding a button
+            uint32_t get_hold_gap() const { return controller_.get_hold_gap(); }
+            int get_brightness_step() const { return current_brightness_step_; }
+            int get_color_step() const { return current_color_step_; }
+            // Drives both axes into their nearest end stop. full: assume nothing about the lamp (after a power
+            // cut), otherwise the tracked steps plus their uncertainty and a margin decide how far to go.
+            void calibrate(bool full = false);
             bool is_calibrating() const { return is_calibrating_; }
+            uint32_t get_last_calibration_ms() const { return last_calibration_ms_; }
             bool is_on() const { return current_power_; }
+            uint32_t get_last_latency_ms() const { return last_latency_ms_; }
+            uint32_t get_max_latency_ms() const { return max_latency_ms_; }
+            // Planned length of the running (or last) transition, see plan_eta_()
+            uint32_t get_transition_eta_ms() const { return transition_eta_ms_; }
             void override_power_state(bool state);
 
             // Configuration setters (called by generated code from light.py)
@@ -37,21 +76,52 @@ namespace esphome {
             void set_min_mireds(float mireds) { min_mireds_ = mireds; }
             void set_max_mireds(float mireds) { max_mireds_ = mireds; }
             void set_step_delay(uint32_t delay_ms) { step_delay_ms_ = delay_ms; }
+            void set_repeat_gap(uint32_t gap_us) { controller_.set_repeat_gap(gap_us); }
+            void set_repeat_count(uint8_t count) { controller_.set_repeat_count(count); }
+            void set_frame_loss(float loss) { controller_.set_loss_estimate(loss); }
+            void set_carrier_sense(bool enabled) { controller_.set_carrier_sense(enabled); }
+            void set_listen_remote(bool enabled) { listen_remote_ = enabled; }
+            void set_hold_rate(float steps_per_sec) { controller_.set_hold_rate(steps_per_sec); }
 
            protected:
             // State machine for non-blocking RF step operations
             enum OperationState {
                 IDLE,
                 TOGGLING_POWER,
-                SENDING_BRIGHTNESS,
-                SENDING_COLOR_TEMP,
+                SENDING_STEPS,  // brightness and color steps interleaved, one of each per step_delay, long legs held
+                HOLDING,        // calibration ramps with held buttons, done once the controller is idle
             };
 
+            void apply_values_(const light::LightColorValues& values, float brightness, uint32_t length_ms);
             void process_state_machine_();
-            bool send_step_(bool is_brightness);
-            bool start_transition_(bool& pending, int current, int target, OperationState state, const char* label);
-            void queue_target_(int target, int& target_step, bool& pending, int current, const char* label);
+            bool send_steps_();
+            bool step_due_(int sent, int remaining);
+            // End stop re-anchoring, per axis: the lamp clamps at 0 and at the max step, so steps past an
+            // end put it at a known position without a full calibration sweep
+            struct Anchor {
+                float uncertainty{0};  // expected error of the tracked step, grows with every unconfirmed step
+                float hold_error{0};   // what held legs may be off by, only a leg into the end stop runs it out
+                int end{-1};           // end stop the running leg overshoots into, -1 when not anchoring
+            };
+
+            bool start_axis_(bool& pending, int current, int target, int& remaining, bool& up, Anchor& anchor, int max,
+                             const char* label);
+            void queue_target_(int target, int& target_step, bool& pending, int current, int& remaining, bool& up,
+                               const Anchor& anchor, const char* label);
+            int plan_anchor_(const Anchor& anchor, int current, int target, int max);
+            void track_step_(int& current, bool up, Anchor& anchor, int max, bool intermediate);
+            void finish_anchor_(bool& pending, int& current, int target, int& remaining, bool& up, Anchor& anchor, int max,
+                                const char* label);
+            uint32_t hold_ms_(int remaining, const Anchor& anchor);
+            void track_hold_(int& current, int& remaining, int& sent, bool up, Anchor& anchor, int max);
+            uint32_t step_period_ms_(int bursts);
+            uint32_t steps_ms_(int brightness, int color);
+            uint32_t plan_eta_();
+            void preempt_steps_();
+            void on_remote_frame_(const uint8_t* raw, uint8_t len);
             void publish_current_state_();
+            void journal_();
+            void restore_journal_();
             int mireds_to_percent_(float mireds);
             float percent_to_mireds_(int percent);
 
@@ -71,6 +141,10 @@ namespace esphome {
             // RF controller
             QuntisControl controller_;
 
+            // Model of the lamp fed with frames from the original remote, see on_remote_frame_()
+            bool listen_remote_{true};
+            std::unique_ptr<QuntisLamp> remote_;
+
             // Current tracked state (what we believe the lamp is at)
             bool current_power_{false};
             int current_brightness_step_{0};
@@ -79,8 +153,19 @@ namespace esphome {
             // State machine
             OperationState op_state_{IDLE};
             uint32_t last_step_time_{0};
-            int remaining_steps_{0};
-            bool step_direction_{true};
+            int remaining_brightness_steps_{0};
+            int remaining_color_steps_{0};
+            bool brightness_up_{true};
+            bool color_up_{true};
+            Anchor brightness_anchor_;
+            Anchor color_anchor_;
+            uint32_t transition_start_{0};
+            uint32_t transition_eta_ms_{0};
+            // Pacing of a transition with a length, 0 sends the steps as fast as step_delay allows
+            uint32_t pace_length_ms_{0};
+            uint32_t pace_start_{0};
+            int brightness_sent_{0};
+            int color_sent_{0};
 
             // Queued target values from write_state()
             bool target_power_{false};
@@ -90,11 +175,24 @@ namespace esphome {
             bool has_pending_brightness_{false};
             bool has_pending_color_{false};
 
+            // Settle latency: last write_state() until the final frame of the resulting transition is on air
+            bool latency_pending_{false};
+            uint32_t last_write_time_{0};
+            uint32_t last_latency_ms_{0};
+            uint32_t max_latency_ms_{0};
+            uint32_t latency_count_{0};
+
             // Calibration state
             bool is_calibrating_{false};
+            uint32_t calibration_start_{0};
+            uint32_t last_calibration_ms_{0};
 
             // Skip RF on first write_state (boot restore) since we can't know lamp's actual state
             bool first_write_{true};
+            // Unless the step journal survived the reset, then the tracked state came from there
+            bool journal_restored_{false};
+            // JOURNAL_QUEUED_* axes of the last steps or ramps queued, journaled with them
+            uint8_t last_queued_axes_{0};
 
             // Deferred state publish flag (avoids recursive write_state calls)
             bool needs_state_publish_{false};
@@ -0,0 +1,81 @@
+//
+//  StepJournal - step and packet index journal kept over resets
+//
+#include "step_journal.h"
+
+#include <esp_attr.h>
+#include <esp_system.h>
+
+#include <cstddef>
+#include <cstring>
+
+static const uint16_t JOURNAL_MAGIC = 0x514B;  // "QJ" + 1, bumped with every change of the Record layout
+
+// Kept over every reset but power-on, not initialized at boot
+RTC_NOINIT_ATTR static StepJournal::Record journal[JOURNAL_SIZE];
+
+uint32_t StepJournal::_appends = 0;
+
+bool StepJournal::restore(Record& record) {
+    if (esp_reset_reason() == ESP_RST_POWERON) {
+        clear();
+        return false;
+    }
+    return newest_(record);
+}
+
+bool StepJournal::newest_(Record& record) {
+    bool found = false;
+    for (int i = 0; i < JOURNAL_SIZE; i++) {
+        const Record& r = journal[i];
+        if (r.magic != JOURNAL_MAGIC || r.crc != crc_(r)) continue;
+        if (!found || (int16_t)(r.seq - record.seq) > 0) {
+            record = r;
+            found = true;
+        }
+    }
+    return found;
+}
+
+void StepJournal::append(bool power, int brightness, int color, int brightness_target, int color_target,
+                         uint8_t queued, uint8_t index) {
+    Record last;
+    bool has_last = newest_(last);
+
+    Record r;
+    r.magic = JOURNAL_MAGIC;
+    r.seq = has_last ? last.seq + 1 : 0;
+    r.power = power;
+    r.brightness = brightness;
+    r.color = color;
+    r.brightness_target = brightness_target;
+    r.color_target = color_target;
+    r.queued = queued;
+    r.index = index;
+    if (has_last && last.power == r.power && last.brightness == r.brightness && last.color == r.color &&
+        last.brightness_target == r.brightness_target && last.color_target == r.color_target &&
+        last.queued == r.queued && last.index == r.index) {
+        return;
+    }
+    r.crc = crc_(r);
+
+    journal[r.seq % JOURNAL_SIZE] = r;
+    _appends++;
+}
+
+void StepJournal::clear() {
+    memset(journal, 0, sizeof(journal));
+}
+
+// CRC-8 (poly 0x07) over everything before the crc field
+uint8_t StepJournal::crc_(const Record& record) {
+    const uint8_t* data = (const uint8_t*)&record;
+    uint8_t crc = 0;
+    for (size_t i = 0; i < offsetof(Record, crc); i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1;
+        }
+    }
+    return crc;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+//
+//  StepJournal - ring of state records in RTC memory, written after every RF command, so a
+//  reset in the middle of a ramp comes back knowing the step the lamp is at and the packet
+//  index it saw
+//
+
+#include <cstdint>
+
+#define JOURNAL_SIZE 8  // records in the ring, the newest valid one wins
+
+// Axes of the last command queued, it may not have made it on air before the reset
+#define JOURNAL_QUEUED_BRIGHTNESS 0x01
+#define JOURNAL_QUEUED_COLOR 0x02
+
+class StepJournal {
+ public:
+  struct Record {
+    uint16_t magic;
+    uint16_t seq;
+    uint8_t power;
+    uint8_t brightness;         // step the lamp is at
+    uint8_t color;
+    uint8_t brightness_target;  // step it was heading for
+    uint8_t color_target;
+    uint8_t queued;             // JOURNAL_QUEUED_* bits
+    uint8_t index;              // next packet index
+    uint8_t crc;
+  };
+
+  // Newest record that is intact, false after a power-on (RTC memory is garbage then) or
+  // when nothing was written yet
+  static bool restore(Record &record);
+
+  // Writes the next slot, the one before stays valid until this one is complete. Records
+  // equal to the newest one are skipped.
+  static void append(bool power, int brightness, int color, int brightness_target, int color_target, uint8_t queued,
+                     uint8_t index);
+  static void clear();
+
+  static uint32_t get_append_count() { return _appends; }
+
+ private:
+  static bool newest_(Record &record);
+  static uint8_t crc_(const Record &record);
+
+  static uint32_t _appends;
+};
@@ -15,11 +15,6 @@
 
 static const char* const TAG = "xn297";
 
-static uint8_t xn297_addr_len;
-static uint8_t xn297_tx_addr[5];
-static uint8_t xn297_rx_addr[5];
-static uint8_t xn297_crc = 1;
-
 static const uint8_t xn297_scramble[] = {
     0xe3, 0xb1, 0x4b, 0xea, 0x85, 0xbc, 0xe5, 0x66,
     0x0d, 0xae, 0x8c, 0x88, 0x12, 0x69, 0xee, 0x1f,
@@ -34,7 +29,59 @@ static const uint16_t xn297_crc_xorout[] = {
     0x8B17, 0x2920, 0x8B5F, 0x61B1, 0xD391, 0x7401,
     0x2138, 0x129F, 0xB3A0, 0x2988};
 
-static const uint16_t polynomial = 0x1021;
+// CRC-CCITT (polynomial 0x1021), one entry per leading byte: crc = (crc << 8) ^ table[(crc >> 8) ^ byte]
+static const uint16_t xn297_crc_table[256] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+    0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+    0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+    0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+    0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+    0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+    0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+    0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+    0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+    0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+    0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+    0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+    0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+    0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+    0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+    0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+    0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+    0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+    0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+    0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+    0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+    0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+    0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+    0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+    0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+    0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+    0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+    0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+    0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+    0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+    0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0};
+
+// Byte with its bit order mirrored, XN297 sends the payload LSB first
+static const uint8_t xn297_bit_reverse[256] = {
+    0x00, 0x80, 0x40, 0xC0, 0x20, 0xA0, 0x60, 0xE0, 0x10, 0x90, 0x50, 0xD0, 0x30, 0xB0, 0x70, 0xF0,
+    0x08, 0x88, 0x48, 0xC8, 0x28, 0xA8, 0x68, 0xE8, 0x18, 0x98, 0x58, 0xD8, 0x38, 0xB8, 0x78, 0xF8,
+    0x04, 0x84, 0x44, 0xC4, 0x24, 0xA4, 0x64, 0xE4, 0x14, 0x94, 0x54, 0xD4, 0x34, 0xB4, 0x74, 0xF4,
+    0x0C, 0x8C, 0x4C, 0xCC, 0x2C, 0xAC, 0x6C, 0xEC, 0x1C, 0x9C, 0x5C, 0xDC, 0x3C, 0xBC, 0x7C, 0xFC,
+    0x02, 0x82, 0x42, 0xC2, 0x22, 0xA2, 0x62, 0xE2, 0x12, 0x92, 0x52, 0xD2, 0x32, 0xB2, 0x72, 0xF2,
+    0x0A, 0x8A, 0x4A, 0xCA, 0x2A, 0xAA, 0x6A, 0xEA, 0x1A, 0x9A, 0x5A, 0xDA, 0x3A, 0xBA, 0x7A, 0xFA,
+    0x06, 0x86, 0x46, 0xC6, 0x26, 0xA6, 0x66, 0xE6, 0x16, 0x96, 0x56, 0xD6, 0x36, 0xB6, 0x76, 0xF6,
+    0x0E, 0x8E, 0x4E, 0xCE, 0x2E, 0xAE, 0x6E, 0xEE, 0x1E, 0x9E, 0x5E, 0xDE, 0x3E, 0xBE, 0x7E, 0xFE,
+    0x01, 0x81, 0x41, 0xC1, 0x21, 0xA1, 0x61, 0xE1, 0x11, 0x91, 0x51, 0xD1, 0x31, 0xB1, 0x71, 0xF1,
+    0x09, 0x89, 0x49, 0xC9, 0x29, 0xA9, 0x69, 0xE9, 0x19, 0x99, 0x59, 0xD9, 0x39, 0xB9, 0x79, 0xF9,
+    0x05, 0x85, 0x45, 0xC5, 0x25, 0xA5, 0x65, 0xE5, 0x15, 0x95, 0x55, 0xD5, 0x35, 0xB5, 0x75, 0xF5,
+    0x0D, 0x8D, 0x4D, 0xCD, 0x2D, 0xAD, 0x6D, 0xED, 0x1D, 0x9D, 0x5D, 0xDD, 0x3D, 0xBD, 0x7D, 0xFD,
+    0x03, 0x83, 0x43, 0xC3, 0x23, 0xA3, 0x63, 0xE3, 0x13, 0x93, 0x53, 0xD3, 0x33, 0xB3, 0x73, 0xF3,
+    0x0B, 0x8B, 0x4B, 0xCB, 0x2B, 0xAB, 0x6B, 0xEB, 0x1B, 0x9B, 0x5B, 0xDB, 0x3B, 0xBB, 0x7B, 0xFB,
+    0x07, 0x87, 0x47, 0xC7, 0x27, 0xA7, 0x67, 0xE7, 0x17, 0x97, 0x57, 0xD7, 0x37, 0xB7, 0x77, 0xF7,
+    0x0F, 0x8F, 0x4F, 0xCF, 0x2F, 0xAF, 0x6F, 0xEF, 0x1F, 0x9F, 0x5F, 0xDF, 0x3F, 0xBF, 0x7F, 0xFF};
 static const uint16_t initial = 0xb5d2;
 
 XN297::XN297(rf24_gpio_pin_t _cepin, rf24_gpio_pin_t _cspin) : RF24(_cepin, _cspin) {
@@ -42,32 +89,19 @@ XN297::XN297(rf24_gpio_pin_t _cepin, rf24_gpio_pin_t _cspin) : RF24(_cepin, _csp
 }
 
 uint8_t XN297::bit_reverse(uint8_t b_in) {
-    uint8_t b_out = 0;
-    for (uint8_t i = 0; i < 8; ++i) {
-        b_out = (b_out << 1) | (b_in & 1);
-        b_in >>= 1;
-    }
-    return b_out;
+    return xn297_bit_reverse[b_in];
 }
 
 uint16_t XN297::crc16_update(uint16_t crc, unsigned char a) {
-    crc ^= a << 8;
-    for (uint8_t i = 0; i < 8; ++i) {
-        if (crc & 0x8000) {
-            crc = (crc << 1) ^ polynomial;
-        } else {
-            crc = crc << 1;
-        }
-    }
-    return crc;
+    return (crc << 8) ^ xn297_crc_table[(crc >> 8) ^ a];
 }
 
 void XN297::XN297_SetTXAddr(const uint8_t* addr, uint8_t len) {
     if (len > 5) len = 5;
     if (len < 3) len = 3;
     uint8_t buf[] = {0x55, 0x0F, 0x71, 0x0C, 0x00};
-    xn297_addr_len = len;
-    if (xn297_addr_len < 4) {
+    _addrLen = len;
+    if (_addrLen < 4) {
         for (uint8_t i = 0; i < 4; ++i) {
             buf[i] = buf[i + 1];
         }
@@ -76,35 +110,161 @@ void XN297::XN297_SetTXAddr(const uint8_t* addr, uint8_t len) {
     write_register(SETUP_AW, len - 2);
     write_register(TX_ADDR, buf, 5);
 
-    memcpy(xn297_tx_addr, addr, len);
+    memcpy(_txAddr, addr, len);
 }
 
 uint8_t XN297::XN297_WritePayload(uint8_t* msg, uint8_t len) {
-    uint8_t buf[32];
-    uint8_t res;
+    XN297_Frame frame;
+    XN297_PrepareFrame(frame, msg, len, len);
+    return XN297_WriteFrame(frame.buf, XN297_FinishFrame(frame, msg));
+}
+
+// Encode the address and the first prefix_len payload bytes once and keep the CRC state,
+// so XN297_FinishFrame only encodes the bytes that change between packets.
+// Without addr the address from XN297_SetTXAddr is used.
+void XN297::XN297_PrepareFrame(XN297_Frame& frame, const uint8_t* msg, uint8_t prefix_len, uint8_t len) {
+    XN297_PrepareFrame(frame, _txAddr, msg, prefix_len, len);
+}
+
+void XN297::XN297_PrepareFrame(XN297_Frame& frame, const uint8_t* addr, const uint8_t* msg, uint8_t prefix_len, uint8_t len) {
+    uint8_t addr_len = _addrLen;
     uint8_t last = 0;
-    if (xn297_addr_len < 4) {
-        buf[last++] = 0x55;
+    if (addr_len < 4) {
+        frame.buf[last++] = 0x55;
     }
-    for (uint8_t i = 0; i < xn297_addr_len; ++i) {
-        buf[last++] = xn297_tx_addr[xn297_addr_len - i - 1] ^ xn297_scramble[i];
+    for (uint8_t i = 0; i < addr_len; ++i) {
+        frame.buf[last++] = addr[addr_len - i - 1] ^ xn297_scramble[i];
     }
 
-    for (uint8_t i = 0; i < len; ++i) {
-        uint8_t b_out = bit_reverse(msg[i]);
-        buf[last++] = b_out ^ xn297_scramble[xn297_addr_len + i];
+    for (uint8_t i = 0; i < prefix_len; ++i) {
+        frame.buf[last++] = bit_reverse(msg[i]) ^ xn297_scramble[addr_len + i];
     }
-    if (xn297_crc) {
-        uint8_t offset = xn297_addr_len < 4 ? 1 : 0;
-        uint16_t crc = initial;
-        for (uint8_t i = offset; i < last; ++i) {
-            crc = crc16_update(crc, buf[i]);
-        }
-        crc ^= xn297_crc_xorout[xn297_addr_len - 3 + len];
-        buf[last++] = crc >> 8;
-        buf[last++] = crc & 0xff;
+
+    uint8_t offset = addr_len < 4 ? 1 : 0;
+    uint16_t crc = initial;
+    for (uint8_t i = offset; i < last; ++i) {
+        crc = crc16_update(crc, frame.buf[i]);
     }
-    res = write(buf, last);
+
+    frame.crc = crc;
+    frame.len = last;
+    frame.addr_len = addr_len;
+    frame.prefix_len = prefix_len;
+    frame.msg_len = len;
+}
+
+// Encode msg[prefix_len..msg_len) behind the prepared prefix and append the CRC,
+// returns the number of bytes in frame.buf
+uint8_t XN297::XN297_FinishFrame(XN297_Frame& frame, const uint8_t* msg) {
+    const uint8_t addr_len = frame.addr_len;
+    const uint8_t msg_len = frame.msg_len;
+    uint8_t last = frame.len;
+    uint16_t crc = frame.crc;
+    for (uint8_t i = frame.prefix_len; i < msg_len; ++i) {
+        uint8_t b_out = bit_reverse(msg[i]) ^ xn297_scramble[addr_len + i];
+        frame.buf[last++] = b_out;
+        crc = crc16_update(crc, b_out);
+    }
+    if (_crcEnabled) {
+        crc ^= xn297_crc_xorout[addr_len - 3 + msg_len];
+        frame.buf[last++] = crc >> 8;
+        frame.buf[last++] = crc & 0xff;
+    }
+    return last;
+}
+
+uint8_t XN297::XN297_WriteFrame(const uint8_t* buf, uint8_t len) {
+    uint8_t res = write(buf, len);
     _nrOfPackets++;
     return res;
 }
+
+// Listen on the same preamble bytes we transmit on, so the scrambled address ends up in the
+// payload and is compared after decoding. Payload size must cover
+// (addr_len < 4 ? 1 : 0) + addr_len + msg len + 2 CRC bytes.
+void XN297::XN297_SetRXAddr(const uint8_t* addr, uint8_t len) {
+    if (len > 5) len = 5;
+    if (len < 3) len = 3;
+    uint8_t buf[] = {0x55, 0x0F, 0x71, 0x0C, 0x00};
+    if (len < 4) {
+        for (uint8_t i = 0; i < 4; ++i) {
+            buf[i] = buf[i + 1];
+        }
+    }
+
+    write_register(SETUP_AW, len - 2);
+    openReadingPipe(0, buf);  // not write_register, startListening() would close pipe 0 again
+
+    _addrLen = len;
+    memcpy(_rxAddr, addr, len);
+}
+
+// Read one frame from the RX FIFO, returns 1 when CRC and address match
+uint8_t XN297::XN297_ReadPayload(uint8_t* msg, uint8_t len) {
+    uint8_t buf[32];
+    uint8_t offset = _addrLen < 4 ? 1 : 0;
+    if (offset + _addrLen + len + 2 > (int)sizeof(buf)) {
+        return 0;
+    }
+    read(buf, offset + _addrLen + len + 2);
+
+    uint8_t addr[5];
+    if (!XN297_Decode(buf + offset, _addrLen, addr, msg, len)) {
+        return 0;
+    }
+    return memcmp(addr, _rxAddr, _addrLen) == 0;
+}
+
+// Inverse of the frame encoding: raw starts at the scrambled address and holds
+// addr_len + len + 2 bytes. Fills addr and msg, returns true when the CRC matches.
+bool XN297::XN297_Decode(const uint8_t* raw, uint8_t addr_len, uint8_t* addr, uint8_t* msg, uint8_t len) {
+    if (addr_len < 3 || addr_len > 5 || addr_len - 3 + len >= (int)(sizeof(xn297_crc_xorout) / sizeof(xn297_crc_xorout[0]))) {
+        return false;
+    }
+
+    uint16_t crc = initial;
+    for (uint8_t i = 0; i < addr_len; ++i) {
+        crc = crc16_update(crc, raw[i]);
+        addr[addr_len - i - 1] = raw[i] ^ xn297_scramble[i];
+    }
+    for (uint8_t i = 0; i < len; ++i) {
+        uint8_t b_in = raw[addr_len + i];
+        crc = crc16_update(crc, b_in);
+        msg[i] = bit_reverse(b_in ^ xn297_scramble[addr_len + i]);
+    }
+    crc ^= xn297_crc_xorout[addr_len - 3 + len];
+
+    return raw[addr_len + len] == (crc >> 8) && raw[addr_len + len + 1] == (crc & 0xff);
+}
+
+// Put a frame in the TX FIFO and keep CE high so it goes out right away, does not wait
+// for it to be sent. Returns false when the 3-deep FIFO is full.
+bool XN297::XN297_QueueFrame(const uint8_t* buf, uint8_t len) {
+    if (isFifo(true, false)) {
+        return false;
+    }
+    startFastWrite(buf, len, false, true);
+    _nrOfPackets++;
+    return true;
+}
+
+// True once everything queued with XN297_QueueFrame is on air, CE is dropped then
+bool XN297::XN297_TxDrained() {
+    if (!isFifo(true, true)) {
+        return false;
+    }
+    txStandBy();
+    return true;
+}
+
+// RX needs 130us to settle and RPD another 40us of carrier, so end the sense 170us or more after
+// starting it. Ending costs the switch back to TX (txDelay in stopListening).
+void XN297::XN297_StartSense() {
+    startListening();
+}
+
+bool XN297::XN297_EndSense() {
+    bool busy = testRPD();
+    stopListening();
+    return busy;
+}